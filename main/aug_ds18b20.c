@@ -1,90 +1,643 @@
 #include "aug_ds18b20.h"
 
 #include <assert.h>
+#include <math.h>
+#include <stdlib.h>
 #include <string.h>
+#include <stdatomic.h>
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
 #include <esp_event.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 
-#include "onewire_bus.h"
-#include "ds18b20.h"
+#include "onewire_crc.h"
 
 #include "aug_utility.h"
+#include "aug_onewire.h"
+#include "aug_history.h"
+#include "aug_metrics.h"
+#include "aug_trace.h"
 
-#define DEFAULT_ONEWIRE_BUS_GPIO CONFIG_ONEWIRE_BUS_GPIO
-#define DEFAULT_ONEWIRE_MAX_DS18B20 CONFIG_ONEWIRE_MAX_DS18B20
+#define DEFAULT_ONEWIRE_BUS_GPIOS CONFIG_ONEWIRE_BUS_GPIOS
+#define DEFAULT_DS18B20_RESOLUTION AUG_DS18B20_RESOLUTION_12B
+#if defined(CONFIG_ADAPTIVE_RESOLUTION)
+#define DEFAULT_ADAPTIVE_RESOLUTION true
+#define DEFAULT_MAX_SKIPPED_SWEEPS CONFIG_MAX_SKIPPED_SWEEPS
+#else
+#define DEFAULT_ADAPTIVE_RESOLUTION false
+#define DEFAULT_MAX_SKIPPED_SWEEPS 0
+#endif
+#if defined(CONFIG_ONEWIRE_BACKEND_SIM)
+#define DEFAULT_SIM_DS18B20_NUM CONFIG_SIM_DS18B20_NUM
+#define DEFAULT_SIM_CRC_ERROR_RATE CONFIG_SIM_CRC_ERROR_RATE
+#define DEFAULT_SIM_DROPOUT_RATE CONFIG_SIM_DROPOUT_RATE
+#endif
+
+#define SAMPLER_TASK_STACK_SIZE (1024 * 3)
+#define SAMPLER_TASK_PRIORITY 6
+#define BUS_TASK_STACK_SIZE (1024 * 2)
+/* Every RMT bus takes a TX and an RX channel. */
+#define ONEWIRE_MAX_BUSES 4
+#define SEARCH_INITIAL_CAPACITY 8
+
+/* Rate of change is kept in 1/256 Celsius per sweep (raw register units scaled by 16).
+ * The thresholds select the resolution whose step is close to the change per sweep. */
+#define RATE_SHIFT 4
+#define RATE_EMA_SHIFT 2
+#define RATE_12B_THRESHOLD (1 << RATE_SHIFT)
+#define RATE_11B_THRESHOLD (RATE_12B_THRESHOLD / 2)
+#define RATE_10B_THRESHOLD (RATE_12B_THRESHOLD / 4)
+
+/**
+ * @brief Scheduling state of a sensor.
+ */
+typedef struct {
+    aug_ds18b20_resolution_t resolution;  // Requested resolution, chosen by the scheduler if adaptive
+    aug_ds18b20_resolution_t configured;  // Resolution written to the configuration register
+    bool adaptive;
+    bool has_last;
+    int16_t last_raw;
+    aug_ds18b20_resolution_t last_resolution; // Resolution the last reading was converted at
+    uint32_t rate;                        // Moving average of the change per sweep
+    uint32_t skipped;                     // Sweeps skipped since the last conversion
+    uint8_t bus;                          // Index of the bus the sensor is connected to
+} sensor_state_t;
+
+/**
+ * @brief Bus with its own sensor table and conversion cycle. Sensors of the bus 
+ *        take the consecutive indexes starting from the first one.
+ */
+typedef struct {
+    int gpio;
+    aug_onewire_bus_t* bus;
+    size_t first;
+    size_t sensors_number;
+    TaskHandle_t task;                    // Samples the bus concurrently, NULL for the first bus sampled by the sampler
+} bus_state_t;
 
 static const char *TAG = "DS18B20S"; 
 
 static bool is_initialized = false;
 static int ds18b20_device_num = 0;
-static ds18b20_device_handle_t ds18b20s[DEFAULT_ONEWIRE_MAX_DS18B20];
+static uint64_t* ds18b20_addresses = NULL;
+static sensor_state_t* sensor_states = NULL;
+static bus_state_t buses[ONEWIRE_MAX_BUSES] = {};
+static size_t buses_number = 0;
+
+static TaskHandle_t sampler_task_handle = NULL;
+/* The sampler is stopped between sweeps: it takes the request instead of sleeping, 
+ * stops the bus tasks once they are idle and gives the acknowledgement back. */
+static SemaphoreHandle_t stop_request = NULL;
+static SemaphoreHandle_t stop_done = NULL;
+static atomic_bool is_stopping = false;
+/* Sweep state shared with the bus tasks, each task writes only the sensors of its bus. */
+static aug_ds18b20_reading_t* sweep_readings = NULL;
+static bool* sweep_due = NULL;
+static uint32_t current_sweep = 0;
+static aug_history_t* history = NULL;
+static aug_ds18b20_sweep_callback_t sweep_callback = NULL;
+static void* sweep_callback_arg = NULL;
+/* Seqlock protecting the snapshot: odd while the sampler is writing, even otherwise.
+ * The sampler is the only writer, readers retry until they copy a stable snapshot. */
+static atomic_uint snapshot_seq = 0;
+static uint32_t snapshot_sweep = 0;
+static aug_ds18b20_reading_t* snapshot = NULL;
 
-static esp_err_t initialize_onewire_bus(onewire_bus_handle_t *bus)
+/**
+ * @brief Returns the maximum conversion time from the DS18B20 datasheet.
+ * @param resolution Resolution the sensors are configured to.
+ * @return uint32_t Conversion time in milliseconds.
+ */
+static uint32_t get_conversion_time_ms(aug_ds18b20_resolution_t resolution)
 {
-    onewire_bus_config_t bus_config = {
-        .bus_gpio_num = DEFAULT_ONEWIRE_BUS_GPIO,
-    };
-    onewire_bus_rmt_config_t rmt_config = {
-        .max_rx_bytes = 10, // 1byte ROM command + 8byte ROM number + 1byte device command
-    };
+    switch (resolution) {
+        case AUG_DS18B20_RESOLUTION_9B:
+            return 94;
+        case AUG_DS18B20_RESOLUTION_10B:
+            return 188;
+        case AUG_DS18B20_RESOLUTION_11B:
+            return 375;
+        default:
+            return 750;
+    }
+}
 
-    AUG_RETURN_CHECK(onewire_new_bus_rmt(&bus_config, &rmt_config, bus));
-    ESP_LOGI(TAG, "1-Wire bus installed on GPIO%d", DEFAULT_ONEWIRE_BUS_GPIO);
-    return ESP_OK;
+/**
+ * @brief Converts the conversion time to the delay in ticks. The time is rounded up to whole ticks 
+ *        and one tick is added, since the current tick is already partly elapsed when the delay starts.
+ */
+static TickType_t get_conversion_delay(uint32_t time_ms)
+{
+    return pdMS_TO_TICKS(time_ms + portTICK_PERIOD_MS - 1) + 1;
 }
 
-static esp_err_t search_ds18b20_devices(onewire_bus_handle_t bus)
+/**
+ * @brief Parses the comma-separated list of the bus GPIOs from the project configuration.
+ * @return esp_err_t 
+ *      - ESP_OK: Succeeds 
+ *      - ESP_ERR_INVALID_ARG: The list is empty, malformed or longer than ONEWIRE_MAX_BUSES
+ */
+static esp_err_t parse_bus_gpios(void)
 {
-    onewire_device_iter_handle_t iter = NULL;
-    onewire_device_t next_onewire_device;
-    esp_err_t search_result = ESP_OK;
+    const char* str = DEFAULT_ONEWIRE_BUS_GPIOS;
+    buses_number = 0;
+    while (*str) {
+        char* end = NULL;
+        long gpio = strtol(str, &end, 10);
+        if (end == str || gpio < 0 || buses_number >= ONEWIRE_MAX_BUSES)
+            return ESP_ERR_INVALID_ARG;
+        buses[buses_number++] = (bus_state_t){ .gpio = gpio };
+        str = end;
+        while (*str == ' ' || *str == ',')
+            ++str;
+    }
+    return buses_number > 0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
 
-    AUG_RETURN_CHECK(onewire_new_device_iter(bus, &iter));
-    ESP_LOGI(TAG, "Device iterator created, start searching...");
+/**
+ * @brief Creates the bus backend selected in the project configuration.
+ * @param gpio GPIO number of the bus.
+ * @param bus Pointer to store the created bus.
+ * @return esp_err_t 
+ *      - ESP_OK: Succeeds 
+ *      - others: Refer to error codes in esp_err.h
+ */
+static esp_err_t initialize_onewire_bus(int gpio, aug_onewire_bus_t** bus)
+{
+#if defined(CONFIG_ONEWIRE_BACKEND_SIM)
+    return aug_onewire_new_sim_bus(gpio, DEFAULT_SIM_DS18B20_NUM, DEFAULT_SIM_CRC_ERROR_RATE, 
+        DEFAULT_SIM_DROPOUT_RATE, bus);
+#else
+    return aug_onewire_new_rmt_bus(gpio, bus);
+#endif
+}
 
-    do {
-        search_result = onewire_device_iter_get_next(iter, &next_onewire_device);
-        if (search_result == ESP_OK) {
-            ds18b20_config_t ds_cfg = {};
-            if (ds18b20_new_device(&next_onewire_device, &ds_cfg, &ds18b20s[ds18b20_device_num]) == ESP_OK) {
-                ESP_LOGI(TAG, "Found a DS18B20[%d], address: %016llX", ds18b20_device_num, next_onewire_device.address);
-                ds18b20_device_num++;
-                if (ds18b20_device_num >= DEFAULT_ONEWIRE_MAX_DS18B20) {
-                    ESP_LOGI(TAG, "Max DS18B20 number reached, stop searching...");
-                    break;
-                }
-            } else {
-                ESP_LOGI(TAG, "Found an unknown device, address: %016llX", next_onewire_device.address);
-            }
+/**
+ * @brief Searches the sensors of the bus and appends them to the sensor table.
+ *        The table grows until the search finds fewer sensors than it has room for,
+ *        sensors above AUG_DS18B20_MAX_SENSORS in total are ignored.
+ * @param bus Bus to search.
+ * @return esp_err_t 
+ *      - ESP_OK: Succeeds 
+ *      - ESP_ERR_NO_MEM: The table can't grow
+ *      - others: Refer to error codes in esp_err.h
+ */
+static esp_err_t search_ds18b20_devices(bus_state_t* bus)
+{
+    size_t capacity = SEARCH_INITIAL_CAPACITY;
+    size_t found = 0;
+    while (1) {
+        uint64_t* addresses = realloc(ds18b20_addresses, (ds18b20_device_num + capacity) * sizeof(*addresses));
+        if (!addresses)
+            return ESP_ERR_NO_MEM;
+        ds18b20_addresses = addresses;
+        AUG_RETURN_CHECK(bus->bus->search(bus->bus, &ds18b20_addresses[ds18b20_device_num], capacity, &found));
+        if (found < capacity)
+            break;
+        capacity *= 2;
+    }
+    if (ds18b20_device_num + found > AUG_DS18B20_MAX_SENSORS) {
+        ESP_LOGI(TAG, "Only %d of %u DS18B20 device(s) on GPIO%d are used, the limit is %d sensors",
+            AUG_DS18B20_MAX_SENSORS - ds18b20_device_num, (unsigned)found, bus->gpio, AUG_DS18B20_MAX_SENSORS);
+        found = AUG_DS18B20_MAX_SENSORS - ds18b20_device_num;
+    }
+    bus->first = ds18b20_device_num;
+    bus->sensors_number = found;
+    ds18b20_device_num += found;
+    for (size_t i = bus->first; i < ds18b20_device_num; ++i)
+        ESP_LOGI(TAG, "Found a DS18B20[%u] on GPIO%d, address: %016llX", (unsigned)i, bus->gpio, ds18b20_addresses[i]);
+    return ESP_OK;
+}
+
+/**
+ * @brief Deletes the created buses and frees the sensor tables.
+ * @return esp_err_t 
+ *      - ESP_OK: Succeeds 
+ *      - others: Refer to error codes in esp_err.h
+ */
+static esp_err_t delete_buses(void)
+{
+    esp_err_t result = ESP_OK;
+    for (size_t i = 0; i < buses_number; ++i) {
+        if (buses[i].bus) {
+            esp_err_t del_result = buses[i].bus->del(buses[i].bus);
+            result = result == ESP_OK ? del_result : result;
         }
-    } while (search_result != ESP_ERR_NOT_FOUND);
+        buses[i] = (bus_state_t){};
+    }
+    buses_number = 0;
+    ds18b20_device_num = 0;
+    free(ds18b20_addresses);
+    ds18b20_addresses = NULL;
+    free(sensor_states);
+    sensor_states = NULL;
+    free(snapshot);
+    snapshot = NULL;
+    return result;
+}
+
+/**
+ * @brief Creates every bus of the configuration and searches its sensors.
+ * @return esp_err_t 
+ *      - ESP_OK: Succeeds 
+ *      - ESP_FAIL: No sensors are found on any bus
+ *      - others: Refer to error codes in esp_err.h
+ */
+static esp_err_t initialize_buses(void)
+{
+    AUG_RETURN_CHECK(parse_bus_gpios());
+    for (size_t i = 0; i < buses_number; ++i) {
+        AUG_RETURN_CHECK(initialize_onewire_bus(buses[i].gpio, &buses[i].bus));
+        AUG_RETURN_CHECK(search_ds18b20_devices(&buses[i]));
+    }
 
-    AUG_RETURN_CHECK(onewire_del_device_iter(iter));
-    ESP_LOGI(TAG, "Searching done, %d DS18B20 device(s) found", ds18b20_device_num);
+    ESP_LOGI(TAG, "Searching done, %d DS18B20 device(s) found on %u bus(es)", ds18b20_device_num, (unsigned)buses_number);
     if (ds18b20_device_num <= 0)
         return ESP_FAIL;
+    sensor_states = calloc(ds18b20_device_num, sizeof(*sensor_states));
+    snapshot = calloc(ds18b20_device_num, sizeof(*snapshot));
+    if (!sensor_states || !snapshot)
+        return ESP_ERR_NO_MEM;
+    return ESP_OK;
+}
+
+/**
+ * @brief Returns the bus the sensor is connected to.
+ * @param index Sensor index.
+ */
+static aug_onewire_bus_t* get_bus(size_t index)
+{
+    return buses[sensor_states[index].bus].bus;
+}
+
+/**
+ * @brief Writes the requested resolution to the sensor if it differs from the configured one.
+ * @param index Sensor index.
+ * @return esp_err_t 
+ *      - ESP_OK: Succeeds 
+ *      - others: Refer to error codes in esp_err.h
+ */
+static esp_err_t sync_resolution(size_t index)
+{
+    sensor_state_t* state = &sensor_states[index];
+    aug_ds18b20_resolution_t resolution = state->resolution;
+    if (resolution == state->configured)
+        return ESP_OK;
+
+    // Alarm registers are not used, the resolution is kept in bits R1 R0 of the configuration register.
+    const uint8_t config = (resolution << 5) | 0x1F;
+    aug_onewire_bus_t* bus = get_bus(index);
+    AUG_RETURN_CHECK(bus->write_scratchpad(bus, ds18b20_addresses[index], 0, 0, config));
+    state->configured = resolution;
     return ESP_OK;
 }
 
 static esp_err_t set_resolution_for_devices()
 {
-    for (int i = 0; i < ds18b20_device_num; i++) {
-        AUG_RETURN_CHECK(ds18b20_set_resolution(ds18b20s[i], DS18B20_RESOLUTION_12B));
+    for (size_t bus = 0; bus < buses_number; ++bus) {
+        for (size_t i = buses[bus].first; i < buses[bus].first + buses[bus].sensors_number; i++) {
+            sensor_states[i] = (sensor_state_t) {
+                .resolution = DEFAULT_DS18B20_RESOLUTION,
+                // Forces the first write, the power-on value of the register is not trusted.
+                .configured = (aug_ds18b20_resolution_t)-1,
+                .adaptive = DEFAULT_ADAPTIVE_RESOLUTION,
+                .bus = bus,
+            };
+            AUG_RETURN_CHECK(sync_resolution(i));
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Returns the longest conversion time among the configured sensors.
+ * @return uint32_t Conversion time in milliseconds.
+ */
+static uint32_t get_max_conversion_time_ms()
+{
+    uint32_t max_time = 0;
+    for (int i = 0; i < ds18b20_device_num; ++i) {
+        uint32_t time = get_conversion_time_ms(sensor_states[i].configured);
+        if (time > max_time)
+            max_time = time;
+    }
+    return max_time;
+}
+
+/**
+ * @brief Starts the temperature conversion on every device of every bus at once 
+ *        with Skip ROM command and waits until the conversion is done.
+ * @return esp_err_t 
+ *      - ESP_OK: Succeeds 
+ *      - others: Refer to error codes in esp_err.h
+ */
+static esp_err_t trigger_conversion_for_all()
+{
+    for (int i = 0; i < ds18b20_device_num; ++i)
+        AUG_RETURN_CHECK(sync_resolution(i));
+    for (size_t i = 0; i < buses_number; ++i) {
+        if (buses[i].sensors_number > 0)
+            AUG_RETURN_CHECK(buses[i].bus->trigger_conversion(buses[i].bus, NULL));
     }
+    vTaskDelay(get_conversion_delay(get_max_conversion_time_ms()));
     return ESP_OK;
 }
 
+/**
+ * @brief Returns the mask of bits that are defined at the resolution.
+ * @param resolution Resolution the sensors are configured to.
+ * @return uint16_t Mask for the raw temperature.
+ */
+static uint16_t get_resolution_mask(aug_ds18b20_resolution_t resolution)
+{
+    switch (resolution) {
+        case AUG_DS18B20_RESOLUTION_9B:
+            return 0xFFF8;
+        case AUG_DS18B20_RESOLUTION_10B:
+            return 0xFFFC;
+        case AUG_DS18B20_RESOLUTION_11B:
+            return 0xFFFE;
+        default:
+            return 0xFFFF;
+    }
+}
+
+/**
+ * @brief Reads the scratchpad of the sensor and returns the raw temperature register.
+ * @param index Sensor index.
+ * @param raw Pointer to store the temperature in 1/16 Celsius.
+ * @return esp_err_t 
+ *      - ESP_OK: Succeeds 
+ *      - ESP_ERR_INVALID_CRC: The scratchpad is corrupted
+ *      - others: Refer to error codes in esp_err.h
+ */
+static esp_err_t read_raw_temperature(size_t index, int16_t* raw)
+{
+    uint8_t scratchpad[AUG_ONEWIRE_SCRATCHPAD_SIZE] = {};
+
+    aug_onewire_bus_t* bus = get_bus(index);
+    AUG_RETURN_CHECK(bus->read_scratchpad(bus, ds18b20_addresses[index], scratchpad));
+    if (onewire_crc8(0, scratchpad, AUG_ONEWIRE_SCRATCHPAD_SIZE - 1) != scratchpad[AUG_ONEWIRE_SCRATCHPAD_SIZE - 1])
+        return ESP_ERR_INVALID_CRC;
+
+    *raw = (int16_t)((scratchpad[0] | (scratchpad[1] << 8)) & get_resolution_mask(sensor_states[index].configured));
+    return ESP_OK;
+}
+
+/**
+ * @brief Copies the readings of the finished sweep into the shared snapshot.
+ * @param readings Readings of the sweep.
+ * @param count Number of readings.
+ * @param sweep Sequence number of the sweep.
+ */
+static void write_snapshot(const aug_ds18b20_reading_t* readings, size_t count, uint32_t sweep)
+{
+    unsigned seq = atomic_load_explicit(&snapshot_seq, memory_order_relaxed);
+    atomic_store_explicit(&snapshot_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    memcpy(snapshot, readings, count * sizeof(*readings));
+    snapshot_sweep = sweep;
+
+    atomic_store_explicit(&snapshot_seq, seq + 2, memory_order_release);
+}
+
+/**
+ * @brief Returns the highest resolution whose conversion fits into the sampling period.
+ * @param period_ms Sampling period in milliseconds.
+ * @return aug_ds18b20_resolution_t Highest usable resolution.
+ */
+static aug_ds18b20_resolution_t get_max_resolution(uint32_t period_ms)
+{
+    aug_ds18b20_resolution_t resolution = AUG_DS18B20_RESOLUTION_12B;
+    while (resolution > AUG_DS18B20_RESOLUTION_9B && get_conversion_time_ms(resolution) > period_ms)
+        --resolution;
+    return resolution;
+}
+
+/**
+ * @brief Picks the resolution of an adaptive sensor from its rate of change 
+ *        and decides whether the sensor is converted in this sweep.
+ *        Stable sensors are converted at the lowest resolution and skip up to 
+ *        DEFAULT_MAX_SKIPPED_SWEEPS sweeps, changing ones are converted every sweep at the highest resolution.
+ * @param state Scheduling state of the sensor.
+ * @param max_resolution Highest resolution that fits into the sampling period.
+ * @return bool Whether the sensor is due in this sweep.
+ */
+static bool schedule_sensor(sensor_state_t* state, aug_ds18b20_resolution_t max_resolution)
+{
+    if (!state->adaptive)
+        return true;
+
+    aug_ds18b20_resolution_t resolution = AUG_DS18B20_RESOLUTION_9B;
+    if (!state->has_last || state->rate >= RATE_12B_THRESHOLD)
+        resolution = AUG_DS18B20_RESOLUTION_12B;
+    else if (state->rate >= RATE_11B_THRESHOLD)
+        resolution = AUG_DS18B20_RESOLUTION_11B;
+    else if (state->rate >= RATE_10B_THRESHOLD)
+        resolution = AUG_DS18B20_RESOLUTION_10B;
+    state->resolution = resolution < max_resolution ? resolution : max_resolution;
+
+    if (state->has_last && resolution == AUG_DS18B20_RESOLUTION_9B 
+            && state->skipped < DEFAULT_MAX_SKIPPED_SWEEPS) {
+        ++state->skipped;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Updates the rate of change of the sensor with the new reading.
+ *        Both readings are compared at the coarser of their resolutions, 
+ *        so switching the resolution isn't taken for a change of the temperature.
+ * @param state Scheduling state of the sensor.
+ * @param raw New temperature in 1/16 Celsius converted at the configured resolution.
+ */
+static void update_rate(sensor_state_t* state, int16_t raw)
+{
+    if (state->has_last) {
+        aug_ds18b20_resolution_t coarser = state->configured < state->last_resolution 
+            ? state->configured : state->last_resolution;
+        uint16_t mask = get_resolution_mask(coarser);
+        uint32_t delta = (uint32_t)abs((int16_t)(raw & mask) - (int16_t)(state->last_raw & mask)) << RATE_SHIFT;
+        delta /= state->skipped + 1;
+        state->rate += ((int32_t)delta - (int32_t)state->rate) >> RATE_EMA_SHIFT;
+    }
+    state->last_raw = raw;
+    state->last_resolution = state->configured;
+    state->has_last = true;
+    state->skipped = 0;
+}
+
+/**
+ * @brief Starts the conversion on the due sensors of the bus and waits for the slowest of them.
+ *        Skip ROM is used when every sensor of the bus is due, Match ROM otherwise.
+ * @param bus Bus to convert.
+ * @return esp_err_t 
+ *      - ESP_OK: Succeeds 
+ *      - others: Refer to error codes in esp_err.h
+ */
+static esp_err_t trigger_conversion_for_due(const bus_state_t* bus)
+{
+    const size_t last = bus->first + bus->sensors_number;
+    uint32_t max_time = 0;
+    size_t due_num = 0;
+    for (size_t i = bus->first; i < last; ++i) {
+        if (!sweep_due[i])
+            continue;
+        ++due_num;
+        AUG_RETURN_CHECK(sync_resolution(i));
+        uint32_t time = get_conversion_time_ms(sensor_states[i].configured);
+        if (time > max_time)
+            max_time = time;
+    }
+    if (due_num == 0)
+        return ESP_OK;
+    if (due_num == bus->sensors_number) {
+        AUG_RETURN_CHECK(bus->bus->trigger_conversion(bus->bus, NULL));
+    } else {
+        for (size_t i = bus->first; i < last; ++i) {
+            if (sweep_due[i])
+                AUG_RETURN_CHECK(bus->bus->trigger_conversion(bus->bus, &ds18b20_addresses[i]));
+        }
+    }
+    vTaskDelay(get_conversion_delay(max_time));
+    return ESP_OK;
+}
+
+/**
+ * @brief Converts and reads the due sensors of the bus into the readings of the current sweep.
+ * @param bus_index Index of the bus.
+ */
+static void sample_bus(size_t bus_index)
+{
+    const bus_state_t* bus = &buses[bus_index];
+    esp_err_t conversion_result = trigger_conversion_for_due(bus);
+    if (conversion_result != ESP_OK) {
+        aug_metrics_add(AUG_METRICS_COUNTER_ONEWIRE_ERRORS, 1);
+        aug_trace(AUG_TRACE_EVENT_CONVERSION_FAILED, bus_index, conversion_result);
+    }
+    for (size_t i = bus->first; i < bus->first + bus->sensors_number; ++i) {
+        // Skipped sensors keep the previous reading with its timestamp and sequence.
+        if (!sweep_due[i])
+            continue;
+        int16_t raw = 0;
+        esp_err_t read_result = conversion_result == ESP_OK ? read_raw_temperature(i, &raw) : conversion_result;
+        if (conversion_result == ESP_OK && read_result != ESP_OK) {
+            aug_trace(AUG_TRACE_EVENT_READ_FAILED, i, read_result);
+            aug_metrics_add(read_result == ESP_ERR_INVALID_CRC 
+                ? AUG_METRICS_COUNTER_ONEWIRE_CRC_ERRORS : AUG_METRICS_COUNTER_ONEWIRE_ERRORS, 1);
+        }
+        sweep_readings[i].valid = read_result == ESP_OK;
+        if (sweep_readings[i].valid) {
+            sweep_readings[i].raw = raw;
+            update_rate(&sensor_states[i], raw);
+        }
+        sweep_readings[i].timestamp_us = esp_timer_get_time();
+        sweep_readings[i].sequence = current_sweep;
+    }
+}
+
+/**
+ * @brief Samples one of the buses after the first one whenever the sampler starts a sweep
+ *        and notifies the sampler when it's done.
+ */
+static void bus_task(void* params)
+{
+    const size_t bus_index = (size_t)(uintptr_t)params;
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (atomic_load_explicit(&is_stopping, memory_order_acquire))
+            break;
+        sample_bus(bus_index);
+        xTaskNotifyGive(sampler_task_handle);
+    }
+    xTaskNotifyGive(sampler_task_handle);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Waits until the next sweep like vTaskDelayUntil, but wakes up early on the stop request.
+ * @param last_wake_time Pointer to the time of the last sweep, updated to the next one.
+ * @param period Sampling period in ticks.
+ * @return true If the stop is requested.
+ */
+static bool wait_next_sweep(TickType_t* last_wake_time, TickType_t period)
+{
+    *last_wake_time += period;
+    TickType_t delay = *last_wake_time - xTaskGetTickCount();
+    // The sweep took longer than the period, the next one starts right away.
+    if (delay > period)
+        delay = 0;
+    return xSemaphoreTake(stop_request, delay) == pdTRUE;
+}
+
+static void sampler_task(void* params)
+{
+    const TickType_t period = (TickType_t)(uintptr_t)params;
+    const aug_ds18b20_resolution_t max_resolution = get_max_resolution(pdTICKS_TO_MS(period));
+    uint32_t sweep = 0;
+    TickType_t last_wake_time = xTaskGetTickCount();
+
+    while (1) {
+        ++sweep;
+        size_t due_num = 0;
+        for (int i = 0; i < ds18b20_device_num; ++i) {
+            sweep_due[i] = schedule_sensor(&sensor_states[i], max_resolution);
+            due_num += sweep_due[i];
+        }
+
+        const int64_t sweep_start_us = esp_timer_get_time();
+        current_sweep = sweep;
+        // The other buses are converted and read concurrently with the first one.
+        for (size_t bus = 1; bus < buses_number; ++bus)
+            xTaskNotifyGive(buses[bus].task);
+        sample_bus(0);
+        for (size_t bus = 1; bus < buses_number; ++bus)
+            ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+
+        if (due_num > 0)
+            aug_metrics_observe(AUG_METRICS_HISTOGRAM_CONVERSION_MS, (esp_timer_get_time() - sweep_start_us) / 1000);
+        aug_metrics_set(AUG_METRICS_GAUGE_SAMPLER_STACK_FREE, uxTaskGetStackHighWaterMark(NULL));
+        write_snapshot(sweep_readings, ds18b20_device_num, sweep);
+        // Skipped sensors keep the previous reading, which isn't a new sample.
+        for (int i = 0; i < ds18b20_device_num; ++i) {
+            if (sweep_readings[i].sequence == sweep)
+                aug_history_push(history, i, sweep_readings[i].raw, sweep_readings[i].valid);
+        }
+        if (sweep_callback)
+            sweep_callback(sweep, sweep_callback_arg);
+        if (wait_next_sweep(&last_wake_time, period))
+            break;
+    }
+
+    // The bus tasks are idle between sweeps, they leave their loop once woken up.
+    atomic_store_explicit(&is_stopping, true, memory_order_release);
+    for (size_t bus = 1; bus < buses_number; ++bus)
+        xTaskNotifyGive(buses[bus].task);
+    for (size_t bus = 1; bus < buses_number; ++bus)
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+    xSemaphoreGive(stop_done);
+    vTaskDelete(NULL);
+}
+
 esp_err_t aug_ds18b20_init()
 {
     ESP_LOGI(TAG, "initializing DS18B20");
     ds18b20_device_num = 0;
-    onewire_bus_handle_t bus;
 
-    // Initialize 1-Wire bus and DS18B20 devices
-    AUG_RETURN_CHECK(initialize_onewire_bus(&bus));
-    AUG_RETURN_CHECK(search_ds18b20_devices(bus));
-    AUG_RETURN_CHECK(set_resolution_for_devices());
+    // Initialize 1-Wire buses and DS18B20 devices
+    esp_err_t result = initialize_buses();
+    if (result == ESP_OK)
+        result = set_resolution_for_devices();
+    if (result != ESP_OK) {
+        // Buses created before the failure are deleted, so the init can be retried.
+        delete_buses();
+        return result;
+    }
     is_initialized = true;
     
     return ESP_OK;
@@ -93,9 +646,13 @@ esp_err_t aug_ds18b20_init()
 esp_err_t aug_ds18b20_deinit()
 {
     assert(is_initialized && "ds18b20 is not initialized");
+    if (sampler_task_handle)
+        AUG_RETURN_CHECK(aug_ds18b20_stop_sampler());
     ESP_LOGI(TAG, "deinitializing DS18B20");
-    ds18b20_device_num = 0;
-    memset(ds18b20s, 0, sizeof(ds18b20s));
+    AUG_RETURN_CHECK(delete_buses());
+    snapshot_sweep = 0;
+    aug_history_delete(history);
+    history = NULL;
     is_initialized = false;
     return ESP_OK;
 }
@@ -106,11 +663,217 @@ size_t aug_get_sensors_number()
     return ds18b20_device_num;
 }
 
+/**
+ * @brief Copies the range of readings from the snapshot without blocking the sampler.
+ * @param first Index of the first sensor.
+ * @param count Number of readings, the range should be within the found sensors.
+ * @param out Buffer to store the readings.
+ * @return uint32_t Sweep number of the snapshot.
+ */
+static uint32_t read_snapshot(size_t first, size_t count, aug_ds18b20_reading_t* out)
+{
+    unsigned seq_begin;
+    unsigned seq_end;
+    uint32_t sweep = 0;
+
+    do {
+        seq_begin = atomic_load_explicit(&snapshot_seq, memory_order_acquire);
+        if (seq_begin & 1) {
+            taskYIELD();
+            continue;
+        }
+        memcpy(out, &snapshot[first], count * sizeof(*out));
+        sweep = snapshot_sweep;
+        atomic_thread_fence(memory_order_acquire);
+        seq_end = atomic_load_explicit(&snapshot_seq, memory_order_relaxed);
+    } while ((seq_begin & 1) || seq_begin != seq_end);
+
+    return sweep;
+}
+
 float aug_get_temperature(size_t index)
 {
     assert(is_initialized && "ds18b20 is not initialized");
-    float temperature = 0;
-    ESP_ERROR_CHECK(ds18b20_trigger_temperature_conversion(ds18b20s[index]));
-    ESP_ERROR_CHECK(ds18b20_get_temperature(ds18b20s[index], &temperature));
-    return temperature;
-}
\ No newline at end of file
+    if (index >= ds18b20_device_num)
+        return NAN;
+    int16_t raw = 0;
+    if (sampler_task_handle) {
+        // The bus is owned by the sampler, the latest reading is returned instead.
+        aug_ds18b20_reading_t reading;
+        read_snapshot(index, 1, &reading);
+        return AUG_DS18B20_RAW_TO_CELSIUS(reading.raw);
+    }
+    ESP_ERROR_CHECK(sync_resolution(index));
+    aug_onewire_bus_t* bus = get_bus(index);
+    ESP_ERROR_CHECK(bus->trigger_conversion(bus, &ds18b20_addresses[index]));
+    vTaskDelay(get_conversion_delay(get_conversion_time_ms(sensor_states[index].configured)));
+    ESP_ERROR_CHECK(read_raw_temperature(index, &raw));
+    return AUG_DS18B20_RAW_TO_CELSIUS(raw);
+}
+
+esp_err_t aug_ds18b20_sample_all_raw(int16_t* out, size_t n)
+{
+    assert(is_initialized && "ds18b20 is not initialized");
+    // The buses are owned by the sampler and its bus tasks while it runs.
+    if (sampler_task_handle)
+        return ESP_ERR_INVALID_STATE;
+    size_t count = n < ds18b20_device_num ? n : ds18b20_device_num;
+
+    AUG_RETURN_CHECK(trigger_conversion_for_all());
+    for (size_t i = 0; i < count; ++i)
+        AUG_RETURN_CHECK(read_raw_temperature(i, &out[i]));
+    return ESP_OK;
+}
+
+esp_err_t aug_ds18b20_sample_all(float* out, size_t n)
+{
+    assert(is_initialized && "ds18b20 is not initialized");
+    if (sampler_task_handle)
+        return ESP_ERR_INVALID_STATE;
+    size_t count = n < ds18b20_device_num ? n : ds18b20_device_num;
+
+    // Every register is converted as soon as it is read, so no raw copy of all sensors is kept.
+    AUG_RETURN_CHECK(trigger_conversion_for_all());
+    for (size_t i = 0; i < count; ++i) {
+        int16_t raw = 0;
+        AUG_RETURN_CHECK(read_raw_temperature(i, &raw));
+        out[i] = AUG_DS18B20_RAW_TO_CELSIUS(raw);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Frees the buffers of the sweep and the stop signals once the sampler and the bus tasks are gone.
+ */
+static void free_sampler_resources(void)
+{
+    for (size_t i = 1; i < buses_number; ++i)
+        buses[i].task = NULL;
+    free(sweep_readings);
+    sweep_readings = NULL;
+    free(sweep_due);
+    sweep_due = NULL;
+    if (stop_request)
+        vSemaphoreDelete(stop_request);
+    stop_request = NULL;
+    if (stop_done)
+        vSemaphoreDelete(stop_done);
+    stop_done = NULL;
+}
+
+/**
+ * @brief Deletes the bus tasks if the sampler fails to start. 
+ *        They are still waiting for the first sweep, so they never hold the bus.
+ */
+static void delete_idle_bus_tasks(void)
+{
+    for (size_t i = 1; i < buses_number; ++i) {
+        if (buses[i].task)
+            vTaskDelete(buses[i].task);
+    }
+    free_sampler_resources();
+}
+
+esp_err_t aug_ds18b20_start_sampler(uint32_t period_ms)
+{
+    assert(is_initialized && "ds18b20 is not initialized");
+    assert(!sampler_task_handle && "sampler is already started");
+    ESP_LOGI(TAG, "Starting sampler of %u bus(es) with period %lu ms", (unsigned)buses_number, (unsigned long)period_ms);
+    aug_history_delete(history);
+    history = NULL;
+    AUG_RETURN_CHECK(aug_history_create(ds18b20_device_num, period_ms, &history));
+    sweep_readings = calloc(ds18b20_device_num, sizeof(*sweep_readings));
+    sweep_due = calloc(ds18b20_device_num, sizeof(*sweep_due));
+    stop_request = xSemaphoreCreateBinary();
+    stop_done = xSemaphoreCreateBinary();
+    if (!sweep_readings || !sweep_due || !stop_request || !stop_done) {
+        free_sampler_resources();
+        return ESP_ERR_NO_MEM;
+    }
+    atomic_store_explicit(&is_stopping, false, memory_order_relaxed);
+
+    // The first bus is sampled by the sampler itself.
+    for (size_t i = 1; i < buses_number; ++i) {
+        if (xTaskCreate(bus_task, "bus_task", BUS_TASK_STACK_SIZE, 
+                (void*)(uintptr_t)i, SAMPLER_TASK_PRIORITY, &buses[i].task) != pdPASS) {
+            buses[i].task = NULL;
+            delete_idle_bus_tasks();
+            return ESP_FAIL;
+        }
+    }
+    if (xTaskCreate(sampler_task, "sampler_task", SAMPLER_TASK_STACK_SIZE, 
+            (void*)(uintptr_t)pdMS_TO_TICKS(period_ms), SAMPLER_TASK_PRIORITY, 
+            &sampler_task_handle) != pdPASS) {
+        sampler_task_handle = NULL;
+        delete_idle_bus_tasks();
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t aug_ds18b20_stop_sampler(void)
+{
+    assert(sampler_task_handle && "sampler is not started");
+    ESP_LOGI(TAG, "Stopping sampler");
+    // The current sweep is finished, so the snapshot is left consistent and no bus is in a transaction.
+    xSemaphoreGive(stop_request);
+    xSemaphoreTake(stop_done, portMAX_DELAY);
+    sampler_task_handle = NULL;
+    free_sampler_resources();
+    return ESP_OK;
+}
+
+uint32_t aug_ds18b20_get_readings(aug_ds18b20_reading_t* out, size_t n)
+{
+    assert(is_initialized && "ds18b20 is not initialized");
+    size_t count = n < ds18b20_device_num ? n : ds18b20_device_num;
+    return read_snapshot(0, count, out);
+}
+esp_err_t aug_ds18b20_set_resolution(size_t index, aug_ds18b20_resolution_t resolution)
+{
+    assert(is_initialized && "ds18b20 is not initialized");
+    if (index >= ds18b20_device_num || resolution > AUG_DS18B20_RESOLUTION_12B)
+        return ESP_ERR_INVALID_ARG;
+    // The register is written before the next conversion by the task that owns the bus.
+    sensor_states[index].adaptive = false;
+    sensor_states[index].resolution = resolution;
+    return ESP_OK;
+}
+
+esp_err_t aug_ds18b20_set_adaptive_resolution(size_t index, bool adaptive)
+{
+    assert(is_initialized && "ds18b20 is not initialized");
+    if (index >= ds18b20_device_num)
+        return ESP_ERR_INVALID_ARG;
+    sensor_states[index].skipped = 0;
+    sensor_states[index].adaptive = adaptive;
+    return ESP_OK;
+}
+
+aug_ds18b20_resolution_t aug_ds18b20_get_resolution(size_t index)
+{
+    assert(is_initialized && "ds18b20 is not initialized");
+    assert(index < ds18b20_device_num && "sensor index is out of range");
+    return sensor_states[index].configured;
+}
+
+esp_err_t aug_ds18b20_get_stats(size_t index, aug_history_window_t window, aug_history_stats_t* stats)
+{
+    assert(is_initialized && "ds18b20 is not initialized");
+    if (!history)
+        return ESP_ERR_INVALID_STATE;
+    return aug_history_get_stats(history, index, window, stats);
+}
+
+uint64_t aug_ds18b20_get_address(size_t index)
+{
+    assert(is_initialized && "ds18b20 is not initialized");
+    assert(index < ds18b20_device_num && "sensor index is out of range");
+    return ds18b20_addresses[index];
+}
+
+void aug_ds18b20_set_sweep_callback(aug_ds18b20_sweep_callback_t callback, void* arg)
+{
+    sweep_callback_arg = arg;
+    sweep_callback = callback;
+}
@@ -0,0 +1,126 @@
+#include "aug_heap_check.h"
+
+#if defined(CONFIG_HEAP_CHECK)
+
+#include <stdatomic.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#include "aug_metrics.h"
+#include "aug_mqtt_client.h"
+#include "aug_wifi_sta.h"
+#include "aug_http_server.h"
+
+#define SOAK_TASK_STACK_SIZE (1024 * 2)
+#define SOAK_TASK_PRIORITY 1
+#define SOAK_CONNECT_TIMEOUT_MS (1000 * 30)
+#define SOAK_POLL_INTERVAL_MS 100
+
+static const char *TAG = "heap check";
+
+static uint32_t cycles_number = 0;
+static size_t baseline_free = 0;
+static atomic_uint failures_number;
+static atomic_int last_loss;
+
+esp_err_t aug_heap_check_cycle(const char* name)
+{
+    ++cycles_number;
+    const bool is_intact = heap_caps_check_integrity_all(true);
+    const size_t free_bytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    const size_t largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    const unsigned fragmentation = free_bytes == 0 ? 0 : 100 - largest_block * 100 / free_bytes;
+
+    if (cycles_number <= DEFAULT_HEAP_CHECK_WARMUP_CYCLES) {
+        // Wi-Fi and lwIP keep some buffers once they are used, so the baseline is taken after the warm-up.
+        baseline_free = free_bytes;
+        ESP_LOGI(TAG, "%s cycle %lu: %u free, %u largest block, %u%% fragmentation, warm-up",
+            name, (unsigned long)cycles_number, (unsigned)free_bytes, (unsigned)largest_block, fragmentation);
+        return is_intact ? ESP_OK : ESP_ERR_INVALID_STATE;
+    }
+
+    const int32_t loss = (int32_t)baseline_free - (int32_t)free_bytes;
+    atomic_store_explicit(&last_loss, loss, memory_order_relaxed);
+    aug_metrics_set(AUG_METRICS_GAUGE_HEAP_CYCLE_LOSS_BYTES, loss);
+    ESP_LOGI(TAG, "%s cycle %lu: %u free, %u largest block, %u%% fragmentation, %ld lost",
+        name, (unsigned long)cycles_number, (unsigned)free_bytes, (unsigned)largest_block, fragmentation, (long)loss);
+
+    esp_err_t result = ESP_OK;
+    if (!is_intact) {
+        ESP_LOGE(TAG, "Heap is corrupted after the %s cycle %lu", name, (unsigned long)cycles_number);
+        result = ESP_ERR_INVALID_STATE;
+    }
+    else if (loss > DEFAULT_HEAP_CHECK_TOLERANCE) {
+        ESP_LOGE(TAG, "Heap usage grew by %ld bytes after the %s cycle %lu", (long)loss, name, (unsigned long)cycles_number);
+        result = ESP_ERR_NO_MEM;
+    }
+    if (result != ESP_OK) {
+        atomic_fetch_add_explicit(&failures_number, 1, memory_order_relaxed);
+        aug_metrics_add(AUG_METRICS_COUNTER_HEAP_CHECK_FAILURES, 1);
+    }
+    return result;
+}
+
+/**
+ * @brief Waits for the station to connect and the MQTT client to be started by the connected event.
+ * @return true If the client is started before the timeout.
+ */
+static bool wait_mqtt_started(void)
+{
+    const TickType_t start = xTaskGetTickCount();
+    while (!aug_wifi_sta_is_connected() || !aug_mqtt_is_started()) {
+        if (xTaskGetTickCount() - start >= pdMS_TO_TICKS(SOAK_CONNECT_TIMEOUT_MS))
+            return false;
+        vTaskDelay(pdMS_TO_TICKS(SOAK_POLL_INTERVAL_MS));
+    }
+    return true;
+}
+
+static void soak_task(void* params)
+{
+    esp_event_loop_handle_t* event_loop_handle = (esp_event_loop_handle_t*)params;
+    const TickType_t interval = pdMS_TO_TICKS(DEFAULT_HEAP_SOAK_INTERVAL);
+    ESP_LOGI(TAG, "Starting soak of %d cycles", DEFAULT_HEAP_SOAK_CYCLES);
+
+    for (int cycle = 0; cycle < DEFAULT_HEAP_SOAK_CYCLES; ++cycle) {
+        // The same events switch the modes when the retries are exhausted or the options are posted.
+        esp_event_post_to(*event_loop_handle, AUG_WIFI_STA_EVENTS,
+            AUG_WIFI_STA_EVENT_FAILED_ATTEMPTS, NULL, 0, portMAX_DELAY);
+        vTaskDelay(interval);
+        esp_event_post_to(*event_loop_handle, AUG_HTTP_SERVER_EVENTS,
+            AUG_HTTP_SERVER_EVENT_INIT_STA, NULL, 0, portMAX_DELAY);
+        vTaskDelay(interval);
+        // Restarting the client is exercised only when the station brought it up.
+        if (!wait_mqtt_started()) {
+            ESP_LOGI(TAG, "MQTT client is not started in %d ms, skipping the MQTT step", SOAK_CONNECT_TIMEOUT_MS);
+            continue;
+        }
+        esp_event_post_to(*event_loop_handle, AUG_HTTP_SERVER_EVENTS,
+            AUG_HTTP_SERVER_EVENT_INIT_MQTT, NULL, 0, portMAX_DELAY);
+        vTaskDelay(interval);
+    }
+
+    const unsigned failures = atomic_load_explicit(&failures_number, memory_order_relaxed);
+    const long loss = atomic_load_explicit(&last_loss, memory_order_relaxed);
+    if (failures == 0)
+        ESP_LOGI(TAG, "Soak passed: %d cycles, %ld bytes lost", DEFAULT_HEAP_SOAK_CYCLES, loss);
+    else
+        ESP_LOGE(TAG, "Soak failed: %d cycles, %u failed checks, %ld bytes lost", DEFAULT_HEAP_SOAK_CYCLES, failures, loss);
+    vTaskDelete(NULL);
+}
+
+esp_err_t aug_heap_check_start_soak(esp_event_loop_handle_t* event_loop_handle)
+{
+    if (DEFAULT_HEAP_SOAK_CYCLES == 0)
+        return ESP_OK;
+    if (xTaskCreate(soak_task, "heap_soak_task", SOAK_TASK_STACK_SIZE,
+            event_loop_handle, SOAK_TASK_PRIORITY, NULL) != pdPASS) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+#endif
@@ -0,0 +1,218 @@
+#include "aug_history.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "aug_ds18b20.h"
+
+#define HOUR_MS (60 * 60 * 1000)
+
+static const uint32_t window_durations_ms[AUG_HISTORY_WINDOW_NUM] = {
+    [AUG_HISTORY_WINDOW_1M] =  60 * 1000,
+    [AUG_HISTORY_WINDOW_15M] = 15 * 60 * 1000,
+    [AUG_HISTORY_WINDOW_1H] =  HOUR_MS,
+};
+
+/**
+ * @brief Monotonic queue of sample numbers, truncated to 16 bits, whose values are
+ *        ordered from the front to the back. The front is the extremum of the window.
+ */
+typedef struct {
+    uint16_t* buffer;
+    uint16_t head;
+    uint16_t size;
+} sample_queue_t;
+
+typedef struct {
+    int64_t sum;
+    int64_t sum_squares;
+    uint32_t valid_count;
+    sample_queue_t min_queue;
+    sample_queue_t max_queue;
+} window_state_t;
+
+typedef struct {
+    int16_t* ring;
+    uint32_t sample_count;
+    window_state_t windows[AUG_HISTORY_WINDOW_NUM];
+} sensor_history_t;
+
+struct aug_history {
+    SemaphoreHandle_t lock;
+    size_t sensors_number;
+    uint32_t capacity;
+    uint32_t window_lens[AUG_HISTORY_WINDOW_NUM];
+    sensor_history_t sensors[];
+};
+
+static int16_t get_sample(const aug_history_t* history, const sensor_history_t* sensor, uint32_t sample)
+{
+    return sensor->ring[sample % history->capacity];
+}
+
+/**
+ * @brief Restores the full sample number from the truncated one kept in the queue.
+ */
+static uint32_t get_queue_sample(const sample_queue_t* queue, uint32_t sample_count, uint16_t position)
+{
+    uint16_t truncated = queue->buffer[position];
+    return sample_count - (uint16_t)((uint16_t)sample_count - truncated);
+}
+
+/**
+ * @brief Drops samples that left the window from the front of the queue.
+ */
+static void expire_queue(sample_queue_t* queue, uint32_t window_len, uint32_t sample_count)
+{
+    while (queue->size > 0
+            && sample_count - get_queue_sample(queue, sample_count, queue->head) >= window_len) {
+        queue->head = (queue->head + 1) % window_len;
+        --queue->size;
+    }
+}
+
+/**
+ * @brief Pushes the sample to the back of the queue after dropping the samples it dominates.
+ * @param is_min Whether the queue keeps the minimum, the maximum otherwise.
+ */
+static void push_queue(const aug_history_t* history, const sensor_history_t* sensor, sample_queue_t* queue,
+    uint32_t window_len, uint32_t sample, int16_t value, bool is_min)
+{
+    while (queue->size > 0) {
+        uint16_t back = (queue->head + queue->size - 1) % window_len;
+        int16_t back_value = get_sample(history, sensor, get_queue_sample(queue, sample, back));
+        if (is_min ? back_value < value : back_value > value)
+            break;
+        --queue->size;
+    }
+    queue->buffer[(queue->head + queue->size) % window_len] = (uint16_t)sample;
+    ++queue->size;
+}
+
+esp_err_t aug_history_create(size_t sensors_number, uint32_t period_ms, aug_history_t** history)
+{
+    if (period_ms == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    uint32_t capacity = (HOUR_MS + period_ms - 1) / period_ms;
+    if (capacity > DEFAULT_HISTORY_MAX_SAMPLES)
+        capacity = DEFAULT_HISTORY_MAX_SAMPLES;
+    uint32_t window_lens[AUG_HISTORY_WINDOW_NUM] = {};
+    size_t queue_len_sum = 0;
+    for (int window = 0; window < AUG_HISTORY_WINDOW_NUM; ++window) {
+        uint32_t len = (window_durations_ms[window] + period_ms - 1) / period_ms;
+        window_lens[window] = len < capacity ? len : capacity;
+        queue_len_sum += window_lens[window];
+    }
+
+    // The ring and both queues of every window are kept next to each other per sensor.
+    const size_t sensor_data_size = capacity * sizeof(int16_t) + 2 * queue_len_sum * sizeof(uint16_t);
+    aug_history_t* new_history = calloc(1, sizeof(aug_history_t)
+        + sensors_number * (sizeof(sensor_history_t) + sensor_data_size));
+    if (!new_history)
+        return ESP_ERR_NO_MEM;
+    new_history->lock = xSemaphoreCreateMutex();
+    if (!new_history->lock) {
+        free(new_history);
+        return ESP_ERR_NO_MEM;
+    }
+
+    new_history->sensors_number = sensors_number;
+    new_history->capacity = capacity;
+    for (int window = 0; window < AUG_HISTORY_WINDOW_NUM; ++window)
+        new_history->window_lens[window] = window_lens[window];
+    uint8_t* data = (uint8_t*)&new_history->sensors[sensors_number];
+    for (size_t i = 0; i < sensors_number; ++i) {
+        sensor_history_t* sensor = &new_history->sensors[i];
+        sensor->ring = (int16_t*)data;
+        data += capacity * sizeof(int16_t);
+        for (int window = 0; window < AUG_HISTORY_WINDOW_NUM; ++window) {
+            sensor->windows[window].min_queue.buffer = (uint16_t*)data;
+            data += window_lens[window] * sizeof(uint16_t);
+            sensor->windows[window].max_queue.buffer = (uint16_t*)data;
+            data += window_lens[window] * sizeof(uint16_t);
+        }
+    }
+    *history = new_history;
+    return ESP_OK;
+}
+
+void aug_history_delete(aug_history_t* history)
+{
+    if (!history)
+        return;
+    vSemaphoreDelete(history->lock);
+    free(history);
+}
+
+void aug_history_push(aug_history_t* history, size_t index, int16_t raw, bool valid)
+{
+    assert(index < history->sensors_number && "sensor index is out of range");
+    sensor_history_t* sensor = &history->sensors[index];
+    // Invalid samples are marked in the ring, so they are skipped when they leave the windows.
+    const int16_t sample_value = valid ? raw : INT16_MIN;
+
+    xSemaphoreTake(history->lock, portMAX_DELAY);
+    const uint32_t sample = sensor->sample_count;
+    for (int window = 0; window < AUG_HISTORY_WINDOW_NUM; ++window) {
+        window_state_t* state = &sensor->windows[window];
+        const uint32_t window_len = history->window_lens[window];
+        if (sample >= window_len) {
+            int16_t leaving = get_sample(history, sensor, sample - window_len);
+            if (leaving != INT16_MIN) {
+                state->sum -= leaving;
+                state->sum_squares -= (int32_t)leaving * leaving;
+                --state->valid_count;
+            }
+        }
+        expire_queue(&state->min_queue, window_len, sample);
+        expire_queue(&state->max_queue, window_len, sample);
+    }
+
+    sensor->ring[sample % history->capacity] = sample_value;
+    if (valid) {
+        for (int window = 0; window < AUG_HISTORY_WINDOW_NUM; ++window) {
+            window_state_t* state = &sensor->windows[window];
+            const uint32_t window_len = history->window_lens[window];
+            state->sum += raw;
+            state->sum_squares += (int32_t)raw * raw;
+            ++state->valid_count;
+            push_queue(history, sensor, &state->min_queue, window_len, sample, raw, true);
+            push_queue(history, sensor, &state->max_queue, window_len, sample, raw, false);
+        }
+    }
+    sensor->sample_count = sample + 1;
+    xSemaphoreGive(history->lock);
+}
+
+esp_err_t aug_history_get_stats(aug_history_t* history, size_t index,
+    aug_history_window_t window, aug_history_stats_t* stats)
+{
+    if (index >= history->sensors_number || window >= AUG_HISTORY_WINDOW_NUM)
+        return ESP_ERR_INVALID_ARG;
+    const sensor_history_t* sensor = &history->sensors[index];
+    const window_state_t* state = &sensor->windows[window];
+    *stats = (aug_history_stats_t) {};
+
+    xSemaphoreTake(history->lock, portMAX_DELAY);
+    if (state->valid_count > 0) {
+        const uint32_t sample_count = sensor->sample_count;
+        const uint32_t min_sample = get_queue_sample(&state->min_queue, sample_count, state->min_queue.head);
+        const uint32_t max_sample = get_queue_sample(&state->max_queue, sample_count, state->max_queue.head);
+        const int64_t count = state->valid_count;
+        const float mean_raw = (float)state->sum / count;
+
+        stats->count = state->valid_count;
+        stats->min = AUG_DS18B20_RAW_TO_CELSIUS(get_sample(history, sensor, min_sample));
+        stats->max = AUG_DS18B20_RAW_TO_CELSIUS(get_sample(history, sensor, max_sample));
+        stats->mean = AUG_DS18B20_RAW_TO_CELSIUS(mean_raw);
+        // Kept in integers to avoid cancellation, raw units are 1/16 Celsius, so the variance is scaled by 1/256.
+        const int64_t variance_numerator = count * state->sum_squares - state->sum * state->sum;
+        stats->variance = (float)variance_numerator / (float)(count * count) / 256.0f;
+    }
+    xSemaphoreGive(history->lock);
+    return ESP_OK;
+}
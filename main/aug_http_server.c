@@ -3,22 +3,64 @@
 #include <esp_http_server.h>
 #include <esp_wifi_types.h>
 #include <esp_log.h>
-#include <esp_ota_ops.h>
+#include <esp_timer.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 
 #include "aug_utility.h"
 #include "aug_wifi_sta.h"
 #include "aug_mqtt_client.h"
+#include "aug_publisher.h"
+#include "aug_ds18b20.h"
+#include "aug_ota.h"
+#include "aug_metrics.h"
+#include "aug_trace.h"
+#include "aug_task_stats.h"
 
 static const char *TAG = "http server";
 
-extern const char index_start[] asm("_binary_index_html_start");
-extern const char index_end[] asm("_binary_index_html_end");
+extern const char index_start[] asm("_binary_index_html_gz_start");
+extern const char index_end[] asm("_binary_index_html_gz_end");
+static const char index_etag[] = "\"" INDEX_HTML_MD5 "\"";
 
 static httpd_handle_t server = NULL;
+/* Guards the handle, the sampler task queues the broadcast to it while the server can be stopped. */
+static StaticSemaphore_t server_lock_buffer;
+static SemaphoreHandle_t server_lock = NULL;
 
 ESP_EVENT_DEFINE_BASE(AUG_HTTP_SERVER_EVENTS);
 
-#define OTA_CHUNK_SIZE 1024
+#define MAX_URI_HANDLERS 16 // HTTPD_DEFAULT_CONFIG allows only 8
+#define READINGS_CHUNK_SIZE 1024
+#define READINGS_ENTRY_MAX_SIZE 160
+
+/* Preallocated for the readings endpoint and stream, both run on the server task one at a time. */
+static char* readings_chunk = NULL;
+static aug_ds18b20_reading_t* readings = NULL;
+static size_t readings_number = 0;
+
+#define WS_MAX_CLIENTS 7 // max_open_sockets of HTTPD_DEFAULT_CONFIG
+#define WS_MAX_STALLS CONFIG_WS_MAX_STALLS
+
+/**
+ * @brief Subscriber of the readings stream. It has every sensor read up to sent_sweep, 
+ *        the next frames carry only the sensors read after it.
+ */
+typedef struct {
+    int fd;
+    bool is_synced;           // All sensors were sent once
+    uint32_t sent_sweep;
+    uint32_t stalls;          // Consecutive sweeps the socket couldn't take
+    uint32_t dropped_sweeps;
+} ws_client_t;
+
+/* Clients are touched only by the server task, the sampler task only reads the number of clients. */
+static ws_client_t ws_clients[WS_MAX_CLIENTS] = {};
+static atomic_size_t ws_clients_number = 0;
 
 static void send_bad_request_msg(const char* msg, size_t msg_len, 
     const char* option_str, size_t option_len, httpd_req_t *req)
@@ -50,10 +92,10 @@ static esp_err_t set_str_value(httpd_req_t *req, char* query_str,
             return ESP_ERR_HTTPD_RESULT_TRUNC;
         }
         case ESP_ERR_NOT_FOUND:
-            ESP_LOGI(TAG, "The %s wasn't found", option_str);
+            aug_trace(AUG_TRACE_EVENT_QUERY_OPTION, 0, aug_trace_pack_str(option_str));
             break;
         case ESP_OK: {
-            ESP_LOGI(TAG, "The %s was found, memcpy in struct", option_str);
+            aug_trace(AUG_TRACE_EVENT_QUERY_OPTION, 1, aug_trace_pack_str(option_str));
             memcpy(option_buffer, buffer, buffer_size);
             break;
         }
@@ -79,10 +121,10 @@ static esp_err_t set_int_value(httpd_req_t *req, char* query_str,
             return ESP_ERR_HTTPD_RESULT_TRUNC;
         }
         case ESP_ERR_NOT_FOUND:
-            ESP_LOGI(TAG, "The %s wasn't found", option_str);
+            aug_trace(AUG_TRACE_EVENT_QUERY_OPTION, 0, aug_trace_pack_str(option_str));
             break;
         case ESP_OK: {
-            ESP_LOGI(TAG, "The %s was found, converting to integer", option_str);
+            aug_trace(AUG_TRACE_EVENT_QUERY_OPTION, 1, aug_trace_pack_str(option_str));
             *option_number = atoi(buffer);
             break;
         }
@@ -108,7 +150,7 @@ static esp_err_t set_auth_enum_value(httpd_req_t *req, char* query_str,
             return ESP_ERR_HTTPD_RESULT_TRUNC;
         }
         case ESP_ERR_NOT_FOUND:
-            ESP_LOGI(TAG, "The %s wasn't found", option_str);
+            aug_trace(AUG_TRACE_EVENT_QUERY_OPTION, 0, aug_trace_pack_str(option_str));
             break;
         case ESP_OK: {
             esp_err_t found = aug_str_to_auth_mode(buffer, strlen(buffer), option_enum);
@@ -118,7 +160,7 @@ static esp_err_t set_auth_enum_value(httpd_req_t *req, char* query_str,
                 send_bad_request_msg(msg, sizeof(msg) - 2, option_str, strlen(option_str), req);//-2 for %s
                 return ESP_FAIL;
             }
-            ESP_LOGI(TAG, "The %s was found, converting to enum", option_str);
+            aug_trace(AUG_TRACE_EVENT_QUERY_OPTION, 1, aug_trace_pack_str(option_str));
             break;
         }
         default:
@@ -143,7 +185,7 @@ static esp_err_t set_sae_mode_enum_value(httpd_req_t *req, char* query_str,
             return ESP_ERR_HTTPD_RESULT_TRUNC;
         }
         case ESP_ERR_NOT_FOUND:
-            ESP_LOGI(TAG, "The %s wasn't found", option_str);
+            aug_trace(AUG_TRACE_EVENT_QUERY_OPTION, 0, aug_trace_pack_str(option_str));
             break;
         case ESP_OK: {
             esp_err_t found = aug_str_to_sae_mode(buffer, strlen(buffer), option_enum);
@@ -153,7 +195,7 @@ static esp_err_t set_sae_mode_enum_value(httpd_req_t *req, char* query_str,
                 send_bad_request_msg(msg, sizeof(msg) - 2, option_str, strlen(option_str), req);//-2 for %s
                 return ESP_FAIL;
             }
-            ESP_LOGI(TAG, "The %s was found, converting to enum", option_str);
+            aug_trace(AUG_TRACE_EVENT_QUERY_OPTION, 1, aug_trace_pack_str(option_str));
             break;
         }
         default:
@@ -325,6 +367,61 @@ static esp_err_t set_options_mqtt_handler(httpd_req_t *req)
     return httpd_resp_sendstr(req, "<div>Options are set</div>\r\n");
 }
 
+static esp_err_t set_options_publish(httpd_req_t *req, char* query_str, aug_publisher_config_t* publisher_config)
+{
+    const char report_by_exception_option[] = "report_by_exception";
+    const char deadband_option[] =            "deadband";
+    const char min_interval_option[] =        "min_interval";
+    const char heartbeat_option[] =           "heartbeat";
+
+    AUG_RETURN_CHECK(set_int_value(req, query_str, 
+        report_by_exception_option, &publisher_config->report_by_exception));
+    AUG_RETURN_CHECK(set_int_value(req, query_str, 
+        deadband_option, &publisher_config->deadband));
+    AUG_RETURN_CHECK(set_int_value(req, query_str, 
+        min_interval_option, &publisher_config->min_interval));
+    AUG_RETURN_CHECK(set_int_value(req, query_str, 
+        heartbeat_option, &publisher_config->heartbeat_interval));
+
+    return ESP_OK;
+}
+
+static esp_err_t set_options_publish_handler(httpd_req_t *req)
+{
+    ESP_LOGI(TAG, "URI: /set_options/publish");
+    size_t query_size = httpd_req_get_url_query_len(req);
+    char query_str[query_size + 1] = {};
+    if (httpd_req_get_url_query_str(req, query_str, query_size + 1) != ESP_OK) {
+        send_unexpected_error(req);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Query: %s", query_str);
+
+    // Options are parsed into a copy that replaces the settings under the publisher lock, 
+    // so the publisher never sees a half-applied or invalid config.
+    aug_publisher_config_t new_config;
+    aug_publisher_get_config(&new_config);
+    if (set_options_publish(req, query_str, &new_config) != ESP_OK) {
+        send_unexpected_error(req);
+        return ESP_FAIL;
+    }
+    if (new_config.deadband < 0 || new_config.min_interval < 0 || new_config.heartbeat_interval < 0) {
+        ESP_LOGI(TAG, "The publish options have negative values");
+        httpd_resp_set_status(req, "400 Bad Request");
+        return httpd_resp_sendstr(req, "<div>The publish options should not be negative</div>\r\n");
+    }
+    if (new_config.heartbeat_interval < new_config.min_interval) {
+        ESP_LOGI(TAG, "The heartbeat is shorter than the min interval");
+        httpd_resp_set_status(req, "400 Bad Request");
+        return httpd_resp_sendstr(req, "<div>The heartbeat should not be shorter than the min_interval</div>\r\n");
+    }
+    aug_publisher_set_config(&new_config);
+    ESP_LOGI(TAG, "Options are set");
+    
+    httpd_resp_set_status(req, "200 Success");
+    return httpd_resp_sendstr(req, "<div>Options are set</div>\r\n");
+}
+
 static esp_err_t send_mqtt_info(httpd_req_t *req, aug_mqtt_uri_t* mqtt_uri)
 {
     const char info_str[] = "<div>Trying to connect to mqtt broker with options:<br>\r\n"
@@ -360,40 +457,112 @@ static esp_err_t init_mqtt_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
+/**
+ * @brief Receives the request body into the OTA pipeline buffers, 
+ *        the previous chunk is written to flash while the next one is received.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - others: refer to error code esp_err.h
+ */
+static esp_err_t receive_ota_image(httpd_req_t *req)
+{
+    size_t content_len = req->content_len;
+    while (content_len > 0) {
+        uint8_t* buffer = NULL;
+        AUG_RETURN_CHECK(aug_ota_get_buffer(&buffer));
+        size_t chunk_len = content_len < DEFAULT_OTA_CHUNK_SIZE ? content_len : DEFAULT_OTA_CHUNK_SIZE;
+        size_t received = 0;
+        while (received < chunk_len) {
+            int sent = httpd_req_recv(req, (char*)&buffer[received], chunk_len - received);
+            if (sent == HTTPD_SOCK_ERR_TIMEOUT)
+                continue;
+            if (sent <= 0) {
+                aug_ota_submit(buffer, 0);
+                return ESP_FAIL;
+            }
+            received += sent;
+        }
+        AUG_RETURN_CHECK(aug_ota_submit(buffer, received));
+        content_len -= received;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Parses the type and the required SHA-256 of the update from the query string.
+ * @param type Pointer to store the type of the content.
+ * @param sha256 Buffer of AUG_OTA_SHA256_SIZE bytes to store the expected SHA-256.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - others: the query is invalid or has no SHA-256, the response is sent
+ */
+static esp_err_t get_ota_options(httpd_req_t *req, aug_ota_type_t* type, uint8_t* sha256)
+{
+    const char type_option[] =   "type";
+    const char sha256_option[] = "sha256";
+    char type_str[sizeof("delta")] = {};
+    char sha256_str[AUG_OTA_SHA256_SIZE * 2 + 1] = {};
+
+    *type = AUG_OTA_TYPE_FULL;
+    size_t query_size = httpd_req_get_url_query_len(req);
+    if (query_size > 0) {
+        char query_str[query_size + 1] = {};
+        if (httpd_req_get_url_query_str(req, query_str, query_size + 1) != ESP_OK) {
+            send_unexpected_error(req);
+            return ESP_FAIL;
+        }
+        ESP_LOGI(TAG, "Query: %s", query_str);
+        AUG_RETURN_CHECK(set_str_value(req, query_str, type_option, type_str, sizeof(type_str)));
+        AUG_RETURN_CHECK(set_str_value(req, query_str, sha256_option, sha256_str, sizeof(sha256_str)));
+    }
+
+    if (strcmp(type_str, "delta") == 0) {
+        *type = AUG_OTA_TYPE_DELTA;
+    } else if (type_str[0] != '\0' && strcmp(type_str, "full") != 0) {
+        const char msg[] = "<div>The %s has invalid value</div>\r\n";
+        send_bad_request_msg(msg, sizeof(msg) - 2, type_option, strlen(type_option), req);//-2 for %s
+        return ESP_FAIL;
+    }
+    if (sha256_str[0] == '\0') {
+        const char msg[] = "<div>The %s is required</div>\r\n";
+        send_bad_request_msg(msg, sizeof(msg) - 2, sha256_option, strlen(sha256_option), req);//-2 for %s
+        return ESP_FAIL;
+    }
+    if (aug_hex_to_bytes(sha256_str, strlen(sha256_str), sha256, AUG_OTA_SHA256_SIZE) != ESP_OK) {
+        const char msg[] = "<div>The %s has invalid value</div>\r\n";
+        send_bad_request_msg(msg, sizeof(msg) - 2, sha256_option, strlen(sha256_option), req);//-2 for %s
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
 static esp_err_t ota_update_handler(httpd_req_t *req)
 {
     ESP_LOGI(TAG, "URI: /ota_update");
     esp_event_loop_handle_t* event_loop_handle = (esp_event_loop_handle_t*)req->user_ctx;
-    
-	esp_ota_handle_t ota_handle;
-	const esp_partition_t* ota_partition = esp_ota_get_next_update_partition(NULL);
-	ESP_ERROR_CHECK(esp_ota_begin(ota_partition, OTA_SIZE_UNKNOWN, &ota_handle));
-
-    char buffer[OTA_CHUNK_SIZE];
-	size_t content_len = req->content_len;
-	while (content_len > 0) {
-		int sent = httpd_req_recv(req, buffer,
-            content_len < OTA_CHUNK_SIZE ? content_len : OTA_CHUNK_SIZE);
-		if (sent == HTTPD_SOCK_ERR_TIMEOUT) {
-			continue;
-		}
-        else if (sent <= 0) {
-			send_unexpected_error(req);
-			return ESP_FAIL;
-		}
-		
-        if (esp_ota_write(ota_handle, buffer, sent) != ESP_OK) {
-			send_unexpected_error(req);
-			return ESP_FAIL;
-		}
-		content_len -= sent;
-	}
-	
-    if (esp_ota_end(ota_handle) != ESP_OK 
-            || esp_ota_set_boot_partition(ota_partition) != ESP_OK) {
-		send_unexpected_error(req);
+    aug_ota_type_t type = AUG_OTA_TYPE_FULL;
+    uint8_t sha256[AUG_OTA_SHA256_SIZE] = {};
+
+    if (get_ota_options(req, &type, sha256) != ESP_OK)
+        return ESP_FAIL;
+    if (aug_ota_begin(req->content_len, type, sha256) != ESP_OK) {
+        httpd_resp_set_status(req, "400 Bad Request");
+        return httpd_resp_sendstr(req, "<div>The firmware can't be loaded</div>\r\n");
+    }
+    if (receive_ota_image(req) != ESP_OK) {
+        aug_ota_abort();
+        send_unexpected_error(req);
+        return ESP_FAIL;
+    }
+    esp_err_t result = aug_ota_end();
+    if (result == ESP_ERR_INVALID_CRC) {
+        httpd_resp_set_status(req, "400 Bad Request");
+        return httpd_resp_sendstr(req, "<div>The SHA-256 of the firmware doesn't match</div>\r\n");
+    }
+    if (result != ESP_OK) {
+        send_unexpected_error(req);
         return ESP_FAIL;
-	}
+    }
     if (esp_event_post_to(*event_loop_handle, AUG_HTTP_SERVER_EVENTS, 
             AUG_HTTP_SERVER_EVENT_OTA_UPDATE, NULL, 0, portMAX_DELAY) != ESP_OK) {
         send_unexpected_error(req);
@@ -404,6 +573,24 @@ static esp_err_t ota_update_handler(httpd_req_t *req)
     return httpd_resp_sendstr(req, "<div>Loading firmware complete</div>\r\n");
 }
 
+static esp_err_t ota_status_handler(httpd_req_t *req)
+{
+    ESP_LOGI(TAG, "URI: /ota_status");
+    aug_ota_stats_t stats = {};
+    aug_ota_get_stats(&stats);
+
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer),
+        "{\"in_progress\":%s,\"type\":\"%s\",\"content_size\":%u,\"received\":%u,\"written\":%u,"
+        "\"elapsed_ms\":%lu,\"receive_wait_ms\":%lu,\"write_ms\":%lu,\"throughput\":%lu}",
+        stats.in_progress ? "true" : "false", stats.type == AUG_OTA_TYPE_DELTA ? "delta" : "full", 
+        (unsigned)stats.content_size, 
+        (unsigned)stats.received, (unsigned)stats.written, (unsigned long)stats.elapsed_ms, 
+        (unsigned long)stats.receive_wait_ms, (unsigned long)stats.write_ms, (unsigned long)stats.throughput);
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_sendstr(req, buffer);
+}
+
 static esp_err_t restart_handler(httpd_req_t *req)
 {
     ESP_LOGI(TAG, "URI: /restart");
@@ -419,12 +606,266 @@ static esp_err_t restart_handler(httpd_req_t *req)
     return httpd_resp_sendstr(req, "<div>Rebooting...</div>\r\n");
 }
 
+/**
+ * @brief Formats the reading of the sensor as a JSON object.
+ * @return int Number of written characters, refer to snprintf.
+ */
+static int format_reading(char* buffer, size_t buffer_size, size_t index, const aug_ds18b20_reading_t* reading, 
+    bool is_first)
+{
+    char temperature_str[AUG_TEMPERATURE_STR_SIZE] = "null";
+    if (reading->valid)
+        aug_raw_temperature_to_str(reading->raw, temperature_str, sizeof(temperature_str));
+    return snprintf(buffer, buffer_size, 
+        "%s{\"index\":%u,\"address\":\"%016llX\",\"temperature\":%s,"
+        "\"timestamp_us\":%lld,\"sequence\":%lu}",
+        is_first ? "" : ",", (unsigned)index, aug_ds18b20_get_address(index), temperature_str,
+        reading->timestamp_us, (unsigned long)reading->sequence);
+}
+
+static int format_readings_header(char* buffer, size_t buffer_size, uint32_t sweep)
+{
+    return snprintf(buffer, buffer_size, "{\"sweep\":%lu,\"uptime_us\":%lld,\"sensors\":[", 
+        (unsigned long)sweep, esp_timer_get_time());
+}
+
+static esp_err_t readings_handler(httpd_req_t *req)
+{
+    ESP_LOGI(TAG, "URI: /api/readings");
+    // The snapshot is copied without locking, the bus is never touched on the request path.
+    uint32_t sweep = aug_ds18b20_get_readings(readings, readings_number);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    int len = format_readings_header(readings_chunk, READINGS_CHUNK_SIZE, sweep);
+    for (size_t i = 0; i < readings_number; ++i) {
+        if (READINGS_CHUNK_SIZE - len < READINGS_ENTRY_MAX_SIZE) {
+            AUG_RETURN_CHECK(httpd_resp_send_chunk(req, readings_chunk, len));
+            len = 0;
+        }
+        len += format_reading(&readings_chunk[len], READINGS_CHUNK_SIZE - len, i, &readings[i], i == 0);
+    }
+    len += snprintf(&readings_chunk[len], READINGS_CHUNK_SIZE - len, "]}");
+    AUG_RETURN_CHECK(httpd_resp_send_chunk(req, readings_chunk, len));
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t send_metrics_chunk(const char* data, size_t len, void* arg)
+{
+    return httpd_resp_send_chunk((httpd_req_t*)arg, data, len);
+}
+
+static esp_err_t metrics_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    AUG_RETURN_CHECK(aug_metrics_render(send_metrics_chunk, req));
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t send_trace_chunk(const void* data, size_t len, void* arg)
+{
+    return httpd_resp_send_chunk((httpd_req_t*)arg, (const char*)data, len);
+}
+
+static esp_err_t trace_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"trace.bin\"");
+    AUG_RETURN_CHECK(aug_trace_dump(send_trace_chunk, req));
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+#if defined(CONFIG_TASK_PROFILING)
+static esp_err_t send_tasks_chunk(const char* data, size_t len, void* arg)
+{
+    return httpd_resp_send_chunk((httpd_req_t*)arg, data, len);
+}
+
+static esp_err_t tasks_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    AUG_RETURN_CHECK(aug_task_stats_render(send_tasks_chunk, req));
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+#endif
+
+/**
+ * @brief Checks whether the client already has the current page cached.
+ * @return true If the If-None-Match header contains the ETag of the page.
+ */
+static bool is_index_cached(httpd_req_t *req)
+{
+    size_t header_len = httpd_req_get_hdr_value_len(req, "If-None-Match");
+    if (header_len == 0 || header_len > 128)
+        return false;
+    char header[header_len + 1];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", header, sizeof(header)) != ESP_OK)
+        return false;
+    return strstr(header, index_etag) != NULL;
+}
+
+static bool is_socket_writable(int fd)
+{
+    fd_set write_fds;
+    struct timeval timeout = {};
+    FD_ZERO(&write_fds);
+    FD_SET(fd, &write_fds);
+    return select(fd + 1, NULL, &write_fds, NULL, &timeout) > 0;
+}
+
+static void remove_ws_client(size_t index)
+{
+    ESP_LOGI(TAG, "Readings stream client %d removed, %lu sweeps dropped", 
+        ws_clients[index].fd, (unsigned long)ws_clients[index].dropped_sweeps);
+    ws_clients[index] = ws_clients[--ws_clients_number];
+}
+
+/**
+ * @brief Drops the subscriber of the closed session, so the reused descriptor isn't streamed twice. 
+ *        Replaces the default close of the server, runs on the server task.
+ */
+static void close_session(httpd_handle_t handle, int sockfd)
+{
+    (void)handle;
+    for (size_t i = 0; i < ws_clients_number; ++i) {
+        if (ws_clients[i].fd == sockfd) {
+            remove_ws_client(i);
+            break;
+        }
+    }
+    close(sockfd);
+}
+
+/**
+ * @brief Sends the sensors read since the previous sweep of the client, all of them to a new client, 
+ *        in frames of up to READINGS_CHUNK_SIZE bytes. A frame is sent only if the socket is writable: 
+ *        lwIP reports it so while the send buffer has more than TCP_SNDLOWAT free, 
+ *        which is larger than the frame, so the send never blocks the server task.
+ * @param sweep Sweep of the readings.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - ESP_ERR_TIMEOUT: the socket can't take the next frame, the rest of the sweep is dropped
+ *      - others: the frame can't be sent, refer to httpd_ws_send_frame_async
+ */
+static esp_err_t send_ws_readings(httpd_handle_t handle, ws_client_t* client, uint32_t sweep)
+{
+    size_t i = 0;
+    while (i < readings_number) {
+        const int header_len = format_readings_header(readings_chunk, READINGS_CHUNK_SIZE, sweep);
+        int len = header_len;
+        for (; i < readings_number && READINGS_CHUNK_SIZE - len >= READINGS_ENTRY_MAX_SIZE; ++i) {
+            if (client->is_synced && readings[i].sequence <= client->sent_sweep)
+                continue;
+            len += format_reading(&readings_chunk[len], READINGS_CHUNK_SIZE - len, i, &readings[i], 
+                len == header_len);
+        }
+        if (len == header_len)
+            break;
+        len += snprintf(&readings_chunk[len], READINGS_CHUNK_SIZE - len, "]}");
+        if (!is_socket_writable(client->fd))
+            return ESP_ERR_TIMEOUT;
+        httpd_ws_frame_t frame = {
+            .type = HTTPD_WS_TYPE_TEXT,
+            .payload = (uint8_t*)readings_chunk,
+            .len = len,
+        };
+        AUG_RETURN_CHECK(httpd_ws_send_frame_async(handle, client->fd, &frame));
+    }
+    client->is_synced = true;
+    client->sent_sweep = sweep;
+    return ESP_OK;
+}
+
+/**
+ * @brief Sends the latest readings to every client. A client that can't take them drops the sweep 
+ *        and gets the sensors with the next one, it is closed after WS_MAX_STALLS sweeps in a row. 
+ *        Runs on the server task.
+ * @param arg Handle of the server that queued the work.
+ */
+static void broadcast_readings_work(void* arg)
+{
+    httpd_handle_t handle = (httpd_handle_t)arg;
+    if (ws_clients_number == 0)
+        return;
+
+    uint32_t sweep = aug_ds18b20_get_readings(readings, readings_number);
+    for (size_t i = 0; i < ws_clients_number;) {
+        ws_client_t* client = &ws_clients[i];
+        if (httpd_ws_get_fd_info(handle, client->fd) != HTTPD_WS_CLIENT_WEBSOCKET) {
+            remove_ws_client(i);
+            continue;
+        }
+        esp_err_t result = send_ws_readings(handle, client, sweep);
+        if (result == ESP_ERR_TIMEOUT) {
+            ++client->dropped_sweeps;
+            if (++client->stalls >= WS_MAX_STALLS) {
+                const int fd = client->fd;
+                remove_ws_client(i);
+                httpd_sess_trigger_close(handle, fd);
+                continue;
+            }
+        } else if (result != ESP_OK) {
+            remove_ws_client(i);
+            continue;
+        } else {
+            client->stalls = 0;
+        }
+        ++i;
+    }
+}
+
+/**
+ * @brief Hands the broadcast of the new sweep over to the server task. Runs on the sampler task.
+ */
+static void sweep_callback(uint32_t sweep, void* arg)
+{
+    (void)sweep;
+    if (atomic_load_explicit(&ws_clients_number, memory_order_relaxed) == 0)
+        return;
+    xSemaphoreTake(server_lock, portMAX_DELAY);
+    if (server)
+        httpd_queue_work(server, broadcast_readings_work, server);
+    xSemaphoreGive(server_lock);
+}
+
+static esp_err_t ws_readings_handler(httpd_req_t *req)
+{
+    if (req->method == HTTP_GET) {
+        ESP_LOGI(TAG, "URI: /ws/readings");
+        if (ws_clients_number == WS_MAX_CLIENTS)
+            return ESP_FAIL;
+        ws_clients[ws_clients_number++] = (ws_client_t) {
+            .fd = httpd_req_to_sockfd(req),
+        };
+        return ESP_OK;
+    }
+
+    // The stream is one way, incoming frames are read and discarded, large ones close the session.
+    uint8_t discard[128];
+    httpd_ws_frame_t frame = {};
+    AUG_RETURN_CHECK(httpd_ws_recv_frame(req, &frame, 0));
+    if (frame.len > sizeof(discard))
+        return ESP_ERR_INVALID_SIZE;
+    frame.payload = discard;
+    return httpd_ws_recv_frame(req, &frame, frame.len);
+}
+
 static esp_err_t index_handler(httpd_req_t *req)
 {
     ESP_LOGI(TAG, "URI: /");
     const size_t index_len = index_end - index_start;
 
+    // The page changes only with the firmware, so the client revalidates it by the ETag.
+    httpd_resp_set_hdr(req, "ETag", index_etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    if (is_index_cached(req)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
     httpd_resp_set_type(req, "text/html");
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
     return httpd_resp_send(req, index_start, index_len);
 }
 
@@ -481,6 +922,23 @@ static esp_err_t register_set_options_mqtt_handler(void)
     return httpd_register_uri_handler(server, &set_options_mqtt);
 }
 
+/**
+ * @brief Registers a handler to set report-by-exception options of the publisher.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - others: refer to error code esp_err.h
+ */
+static esp_err_t register_set_options_publish_handler(void)
+{
+    ESP_LOGI(TAG, "Registering set options publish handler");
+    const httpd_uri_t set_options_publish = {
+            .uri       = "/set_options/publish",
+            .method    = HTTP_POST,
+            .handler   = set_options_publish_handler,
+    };
+    return httpd_register_uri_handler(server, &set_options_publish);
+}
+
 /**
  * @brief Registers a handler to publish an event to initialize the MQTT client module.
  * @param context Pointer to the the event loop handle to publish the event to.
@@ -520,6 +978,23 @@ static esp_err_t register_ota_update_handler(esp_event_loop_handle_t* context)
     return httpd_register_uri_handler(server, &ota_update);
 }
 
+/**
+ * @brief Registers a handler to return the progress of the firmware update.
+ * @return esp_err_t
+ *      - ESP_OK: succeed 
+ *      - others: refer to error code esp_err.h
+ */
+static esp_err_t register_ota_status_handler(void)
+{
+    ESP_LOGI(TAG, "Registering ota status handler");
+    const httpd_uri_t ota_status = {
+            .uri       = "/ota_status",
+            .method    = HTTP_GET,
+            .handler   = ota_status_handler,
+    };
+    return httpd_register_uri_handler(server, &ota_status);
+}
+
 /**
  * @brief Registers a handler to restart the esp.
  * @param context Pointer to the the event loop handle to publish the event to.
@@ -539,6 +1014,104 @@ static esp_err_t register_restart_handler(esp_event_loop_handle_t* context)
     return httpd_register_uri_handler(server, &restart);
 }
 
+/**
+ * @brief Registers a handler to stream the latest readings of all sensors as JSON.
+ *        Allocates the buffers the handler formats the response in.
+ * @return esp_err_t
+ *      - ESP_OK: succeed 
+ *      - ESP_ERR_NO_MEM: the buffers can't be allocated
+ *      - others: refer to error code esp_err.h
+ */
+static esp_err_t register_readings_handler(void)
+{
+    ESP_LOGI(TAG, "Registering readings handler");
+    readings_number = aug_get_sensors_number();
+    readings_chunk = malloc(READINGS_CHUNK_SIZE);
+    readings = calloc(readings_number, sizeof(*readings));
+    if (!readings_chunk || !readings)
+        return ESP_ERR_NO_MEM;
+    const httpd_uri_t readings_uri = {
+            .uri       = "/api/readings",
+            .method    = HTTP_GET,
+            .handler   = readings_handler,
+    };
+    return httpd_register_uri_handler(server, &readings_uri);
+}
+
+/**
+ * @brief Registers a handler to export the runtime metrics in the Prometheus text format.
+ * @return esp_err_t
+ *      - ESP_OK: succeed 
+ *      - others: refer to error code esp_err.h
+ */
+static esp_err_t register_metrics_handler(void)
+{
+    ESP_LOGI(TAG, "Registering metrics handler");
+    const httpd_uri_t metrics = {
+            .uri       = "/metrics",
+            .method    = HTTP_GET,
+            .handler   = metrics_handler,
+    };
+    return httpd_register_uri_handler(server, &metrics);
+}
+
+/**
+ * @brief Registers a handler to dump the binary trace ring, decoded with tools/trace_decode.py.
+ * @return esp_err_t
+ *      - ESP_OK: succeed 
+ *      - others: refer to error code esp_err.h
+ */
+static esp_err_t register_trace_handler(void)
+{
+    ESP_LOGI(TAG, "Registering trace handler");
+    const httpd_uri_t trace = {
+            .uri       = "/debug/trace",
+            .method    = HTTP_GET,
+            .handler   = trace_handler,
+    };
+    return httpd_register_uri_handler(server, &trace);
+}
+
+#if defined(CONFIG_TASK_PROFILING)
+/**
+ * @brief Registers a handler reporting the CPU load, the stack high-water mark and the state of every task.
+ * @return esp_err_t
+ *      - ESP_OK: succeed 
+ *      - others: refer to error code esp_err.h
+ */
+static esp_err_t register_tasks_handler(void)
+{
+    ESP_LOGI(TAG, "Registering tasks handler");
+    const httpd_uri_t tasks = {
+            .uri       = "/debug/tasks",
+            .method    = HTTP_GET,
+            .handler   = tasks_handler,
+    };
+    return httpd_register_uri_handler(server, &tasks);
+}
+#endif
+
+/**
+ * @brief Registers a WebSocket handler that pushes the readings of every sweep to the subscribers.
+ * @return esp_err_t
+ *      - ESP_OK: succeed 
+ *      - others: refer to error code esp_err.h
+ */
+static esp_err_t register_ws_readings_handler(void)
+{
+    ESP_LOGI(TAG, "Registering readings stream handler");
+    ws_clients_number = 0;
+    const httpd_uri_t ws_readings = {
+            .uri          = "/ws/readings",
+            .method       = HTTP_GET,
+            .handler      = ws_readings_handler,
+            .is_websocket = true,
+    };
+    AUG_RETURN_CHECK(httpd_register_uri_handler(server, &ws_readings));
+    aug_ds18b20_set_sweep_callback(sweep_callback, NULL);
+    return ESP_OK;
+}
+
 static esp_err_t register_index(void)
 {
     ESP_LOGI(TAG, "Registering index handler");
@@ -554,15 +1127,31 @@ esp_err_t aug_http_start(esp_event_loop_handle_t* context)
 {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.lru_purge_enable = true;
+    config.max_uri_handlers = MAX_URI_HANDLERS;
+    config.close_fn = close_session;
+    if (!server_lock)
+        server_lock = xSemaphoreCreateMutexStatic(&server_lock_buffer);
     ESP_LOGI(TAG, "Starting server on port: '%d'", config.server_port);
-    AUG_RETURN_CHECK(httpd_start(&server, &config));
+    xSemaphoreTake(server_lock, portMAX_DELAY);
+    esp_err_t err = httpd_start(&server, &config);
+    xSemaphoreGive(server_lock);
+    AUG_RETURN_CHECK(err);
     
     AUG_RETURN_CHECK(register_set_options_sta_handler());
     AUG_RETURN_CHECK(register_init_sta_handler(context));
     AUG_RETURN_CHECK(register_set_options_mqtt_handler());
     AUG_RETURN_CHECK(register_init_mqtt_handler(context));
+    AUG_RETURN_CHECK(register_set_options_publish_handler());
     AUG_RETURN_CHECK(register_ota_update_handler(context));
+    AUG_RETURN_CHECK(register_ota_status_handler());
     AUG_RETURN_CHECK(register_restart_handler(context));
+    AUG_RETURN_CHECK(register_readings_handler());
+    AUG_RETURN_CHECK(register_metrics_handler());
+    AUG_RETURN_CHECK(register_trace_handler());
+#if defined(CONFIG_TASK_PROFILING)
+    AUG_RETURN_CHECK(register_tasks_handler());
+#endif
+    AUG_RETURN_CHECK(register_ws_readings_handler());
     AUG_RETURN_CHECK(register_index());
     return ESP_OK;
 }
@@ -570,8 +1159,18 @@ esp_err_t aug_http_start(esp_event_loop_handle_t* context)
 esp_err_t aug_http_stop_webserver(void)
 {
     ESP_LOGI(TAG, "Stopping server");
-    AUG_RETURN_CHECK(httpd_stop(server));
+    // The sampler may still be in the callback, the handle is cleared under the lock 
+    // so no work is queued to the server being stopped.
+    aug_ds18b20_set_sweep_callback(NULL, NULL);
+    xSemaphoreTake(server_lock, portMAX_DELAY);
+    httpd_handle_t handle = server;
     server = NULL;
+    xSemaphoreGive(server_lock);
+    AUG_RETURN_CHECK(httpd_stop(handle));
+    free(readings_chunk);
+    free(readings);
+    readings_chunk = NULL;
+    readings = NULL;
     return ESP_OK;
 }
 
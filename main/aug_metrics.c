@@ -0,0 +1,165 @@
+#include "aug_metrics.h"
+
+#include <stdio.h>
+#include <stdatomic.h>
+
+#include <esp_system.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+#include "aug_utility.h"
+
+#define HISTOGRAM_MAX_BUCKETS 8
+#define LINE_MAX_SIZE 160
+
+typedef struct {
+    const char* name;
+    const char* help;
+} metric_info_t;
+
+typedef struct {
+    metric_info_t info;
+    uint32_t bounds[HISTOGRAM_MAX_BUCKETS]; // Upper bounds of the buckets, 0 ends the list
+} histogram_info_t;
+
+static const metric_info_t counter_infos[AUG_METRICS_COUNTER_NUM] = {
+    [AUG_METRICS_COUNTER_PUBLISHES] = { "aug_publishes_total", "Messages with readings handed to the MQTT client." },
+    [AUG_METRICS_COUNTER_PUBLISH_FAILURES] = { "aug_publish_failures_total", "Messages with readings the MQTT client refused." },
+    [AUG_METRICS_COUNTER_ONEWIRE_CRC_ERRORS] = { "aug_onewire_crc_errors_total", "DS18B20 scratchpads read with the wrong CRC." },
+    [AUG_METRICS_COUNTER_ONEWIRE_ERRORS] = { "aug_onewire_errors_total", "Failed 1-Wire bus transactions." },
+    [AUG_METRICS_COUNTER_MQTT_CONNECTS] = { "aug_mqtt_connects_total", "Connections to the MQTT broker." },
+    [AUG_METRICS_COUNTER_MQTT_DISCONNECTS] = { "aug_mqtt_disconnects_total", "Disconnections from the MQTT broker." },
+    [AUG_METRICS_COUNTER_MQTT_ERRORS] = { "aug_mqtt_errors_total", "Errors reported by the MQTT client." },
+    [AUG_METRICS_COUNTER_WIFI_CONNECTS] = { "aug_wifi_connects_total", "IP addresses assigned to the station." },
+    [AUG_METRICS_COUNTER_WIFI_RETRIES] = { "aug_wifi_retries_total", "Retries to connect the station to the AP." },
+    [AUG_METRICS_COUNTER_OTA_BYTES] = { "aug_ota_bytes_total", "Bytes of firmware images written to flash." },
+    [AUG_METRICS_COUNTER_HEAP_CHECK_FAILURES] = { "aug_heap_check_failures_total", "Module teardowns that leaked or corrupted the heap." },
+};
+
+static const metric_info_t gauge_infos[AUG_METRICS_GAUGE_NUM] = {
+    [AUG_METRICS_GAUGE_MQTT_OUTBOX_BYTES] = { "aug_mqtt_outbox_bytes", "Bytes waiting in the MQTT outbox." },
+    [AUG_METRICS_GAUGE_PUBLISH_STACK_FREE] = { "aug_publish_task_stack_free_bytes", "Stack high-water mark of the publishing task." },
+    [AUG_METRICS_GAUGE_SAMPLER_STACK_FREE] = { "aug_sampler_task_stack_free_bytes", "Stack high-water mark of the sampling task." },
+    [AUG_METRICS_GAUGE_HEAP_CYCLE_LOSS_BYTES] = { "aug_heap_cycle_loss_bytes", "Free heap lost since the baseline after the last module teardown." },
+    [AUG_METRICS_GAUGE_OTA_WRITER_STACK_FREE] = { "aug_ota_writer_task_stack_free_bytes", "Stack high-water mark of the OTA writer task." },
+    [AUG_METRICS_GAUGE_FIRST_PUBLISH_MS] = { "aug_first_publish_milliseconds", "Time from boot to the first published reading." },
+};
+
+static const histogram_info_t histogram_infos[AUG_METRICS_HISTOGRAM_NUM] = {
+    [AUG_METRICS_HISTOGRAM_CONVERSION_MS] = {
+        { "aug_ds18b20_sweep_milliseconds", "Conversion and reading time of a sampling sweep." },
+        { 100, 200, 400, 800, 1600, 3200 } },
+    [AUG_METRICS_HISTOGRAM_PUBLISH_CYCLE_MS] = {
+        { "aug_publish_cycle_milliseconds", "Time spent publishing and draining in a publish cycle." },
+        { 1, 5, 10, 50, 100, 500, 1000 } },
+};
+
+static atomic_uint counters[AUG_METRICS_COUNTER_NUM];
+static atomic_int gauges[AUG_METRICS_GAUGE_NUM];
+/* The last bucket of every histogram counts the values above all bounds. */
+static atomic_uint histogram_buckets[AUG_METRICS_HISTOGRAM_NUM][HISTOGRAM_MAX_BUCKETS + 1];
+static atomic_uint histogram_sums[AUG_METRICS_HISTOGRAM_NUM];
+
+void aug_metrics_add(aug_metrics_counter_t counter, uint32_t value)
+{
+    atomic_fetch_add_explicit(&counters[counter], value, memory_order_relaxed);
+}
+
+void aug_metrics_set(aug_metrics_gauge_t gauge, int32_t value)
+{
+    atomic_store_explicit(&gauges[gauge], value, memory_order_relaxed);
+}
+
+void aug_metrics_observe(aug_metrics_histogram_t histogram, uint32_t value)
+{
+    const uint32_t* bounds = histogram_infos[histogram].bounds;
+    size_t bucket = 0;
+    while (bucket < HISTOGRAM_MAX_BUCKETS && bounds[bucket] != 0 && value > bounds[bucket])
+        ++bucket;
+    if (bucket < HISTOGRAM_MAX_BUCKETS && bounds[bucket] == 0)
+        bucket = HISTOGRAM_MAX_BUCKETS;
+    atomic_fetch_add_explicit(&histogram_buckets[histogram][bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram_sums[histogram], value, memory_order_relaxed);
+}
+
+static esp_err_t write_header(aug_metrics_write_t write, void* arg, const metric_info_t* info, const char* type)
+{
+    char line[LINE_MAX_SIZE];
+    int len = snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n", info->name, info->help, info->name, type);
+    if (len < 0 || len >= sizeof(line))
+        return ESP_ERR_INVALID_SIZE;
+    return write(line, len, arg);
+}
+
+static esp_err_t write_value(aug_metrics_write_t write, void* arg, const metric_info_t* info, const char* type,
+    long long value)
+{
+    AUG_RETURN_CHECK(write_header(write, arg, info, type));
+    char line[LINE_MAX_SIZE];
+    int len = snprintf(line, sizeof(line), "%s %lld\n", info->name, value);
+    if (len < 0 || len >= sizeof(line))
+        return ESP_ERR_INVALID_SIZE;
+    return write(line, len, arg);
+}
+
+static esp_err_t write_histogram(aug_metrics_write_t write, void* arg, aug_metrics_histogram_t histogram)
+{
+    const histogram_info_t* info = &histogram_infos[histogram];
+    AUG_RETURN_CHECK(write_header(write, arg, &info->info, "histogram"));
+
+    char line[LINE_MAX_SIZE];
+    int len = 0;
+    uint32_t cumulative = 0;
+    for (size_t bucket = 0; bucket < HISTOGRAM_MAX_BUCKETS && info->bounds[bucket] != 0; ++bucket) {
+        cumulative += atomic_load_explicit(&histogram_buckets[histogram][bucket], memory_order_relaxed);
+        len = snprintf(line, sizeof(line), "%s_bucket{le=\"%lu\"} %lu\n",
+            info->info.name, (unsigned long)info->bounds[bucket], (unsigned long)cumulative);
+        if (len < 0 || len >= sizeof(line))
+            return ESP_ERR_INVALID_SIZE;
+        AUG_RETURN_CHECK(write(line, len, arg));
+    }
+    cumulative += atomic_load_explicit(&histogram_buckets[histogram][HISTOGRAM_MAX_BUCKETS], memory_order_relaxed);
+    len = snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %lu\n%s_sum %lu\n%s_count %lu\n",
+        info->info.name, (unsigned long)cumulative,
+        info->info.name, (unsigned long)atomic_load_explicit(&histogram_sums[histogram], memory_order_relaxed),
+        info->info.name, (unsigned long)cumulative);
+    if (len < 0 || len >= sizeof(line))
+        return ESP_ERR_INVALID_SIZE;
+    return write(line, len, arg);
+}
+
+/**
+ * @brief Renders the gauges read from the system at the time of rendering.
+ */
+static esp_err_t write_system_gauges(aug_metrics_write_t write, void* arg)
+{
+    static const metric_info_t uptime = { "aug_uptime_seconds", "Time since boot." };
+    static const metric_info_t free_heap = { "aug_heap_free_bytes", "Free heap." };
+    static const metric_info_t min_free_heap = { "aug_heap_min_free_bytes", "Minimum free heap since boot." };
+    static const metric_info_t largest_block = { "aug_heap_largest_free_block_bytes", "Largest free block of the heap." };
+    static const metric_info_t fragmentation = { "aug_heap_fragmentation_percent", "Free heap outside the largest free block." };
+
+    AUG_RETURN_CHECK(write_value(write, arg, &uptime, "gauge", esp_timer_get_time() / 1000000));
+    AUG_RETURN_CHECK(write_value(write, arg, &free_heap, "gauge", esp_get_free_heap_size()));
+    AUG_RETURN_CHECK(write_value(write, arg, &min_free_heap, "gauge", esp_get_minimum_free_heap_size()));
+    const size_t free_bytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    const size_t largest_free_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    AUG_RETURN_CHECK(write_value(write, arg, &largest_block, "gauge", largest_free_block));
+    return write_value(write, arg, &fragmentation, "gauge",
+        free_bytes == 0 ? 0 : 100 - (long long)(largest_free_block * 100 / free_bytes));
+}
+
+esp_err_t aug_metrics_render(aug_metrics_write_t write, void* arg)
+{
+    for (int counter = 0; counter < AUG_METRICS_COUNTER_NUM; ++counter) {
+        AUG_RETURN_CHECK(write_value(write, arg, &counter_infos[counter], "counter",
+            atomic_load_explicit(&counters[counter], memory_order_relaxed)));
+    }
+    for (int gauge = 0; gauge < AUG_METRICS_GAUGE_NUM; ++gauge) {
+        AUG_RETURN_CHECK(write_value(write, arg, &gauge_infos[gauge], "gauge",
+            atomic_load_explicit(&gauges[gauge], memory_order_relaxed)));
+    }
+    for (int histogram = 0; histogram < AUG_METRICS_HISTOGRAM_NUM; ++histogram)
+        AUG_RETURN_CHECK(write_histogram(write, arg, histogram));
+    return write_system_gauges(write, arg);
+}
@@ -1,10 +1,14 @@
 #include "aug_mqtt_client.h"
 
+#include <string.h>
+
 #include <mqtt_client.h>
 #include <esp_event.h>
 #include <esp_check.h>
 
 #include "aug_utility.h"
+#include "aug_metrics.h"
+#include "aug_trace.h"
 
 static const char *TAG = "mqtt client";
 
@@ -12,6 +16,12 @@ static char uri_str[MQTT_MAX_URI_LEN + 1] = {};
 static esp_mqtt_client_config_t mqtt_config = {};
 static esp_mqtt_client_handle_t mqtt_client_handle = NULL;
 static bool is_connected = false;
+static bool is_started = false;
+static const aug_mqtt_message_t* retained_messages = NULL;
+static size_t retained_messages_number = 0;
+/* Index of the next retained message to enqueue after the connection, touched only by the client task. */
+static size_t retained_messages_next = 0;
+static aug_mqtt_published_callback_t published_callback = NULL;
 
 static void log_error_if_nonzero(const char *message, int error_code)
 {
@@ -20,6 +30,30 @@ static void log_error_if_nonzero(const char *message, int error_code)
     }
 }
 
+/**
+ * @brief Enqueues the retained messages that are left while the outbox is below DEFAULT_OUTBOX_LIMIT.
+ *        Called from the client task on the connection and on every acknowledgement, 
+ *        so the handler never blocks on the socket and the outbox doesn't hold all messages at once.
+ */
+static void enqueue_retained_messages(void)
+{
+    if (retained_messages_next >= retained_messages_number)
+        return;
+    while (retained_messages_next < retained_messages_number 
+            && aug_mqtt_get_outbox_size() <= DEFAULT_OUTBOX_LIMIT) {
+        const aug_mqtt_message_t* message = &retained_messages[retained_messages_next];
+        int msg_id = esp_mqtt_client_enqueue(mqtt_client_handle, message->topic, 
+            message->data, message->data_len, 1, 1, true);
+        if (msg_id < 0) {
+            ESP_LOGI(TAG, "Failed to enqueue retained message, topic=%s", message->topic);
+            return;
+        }
+        ++retained_messages_next;
+    }
+    if (retained_messages_next == retained_messages_number)
+        ESP_LOGI(TAG, "Enqueued %u retained messages", (unsigned)retained_messages_number);
+}
+
 /*
  * @brief Event handler registered to receive MQTT events
  *
@@ -37,10 +71,14 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     case MQTT_EVENT_CONNECTED:
         ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
         is_connected = true;
+        aug_metrics_add(AUG_METRICS_COUNTER_MQTT_CONNECTS, 1);
+        retained_messages_next = 0;
+        enqueue_retained_messages();
         break;
     case MQTT_EVENT_DISCONNECTED:
         ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
         is_connected = false;
+        aug_metrics_add(AUG_METRICS_COUNTER_MQTT_DISCONNECTS, 1);
         break;
     case MQTT_EVENT_SUBSCRIBED:
         ESP_LOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
@@ -49,7 +87,10 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         ESP_LOGI(TAG, "MQTT_EVENT_UNSUBSCRIBED, msg_id=%d", event->msg_id);
         break;
     case MQTT_EVENT_PUBLISHED:
-        ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+        aug_trace(AUG_TRACE_EVENT_MQTT_PUBLISHED, 0, event->msg_id);
+        if (published_callback)
+            published_callback(event->msg_id);
+        enqueue_retained_messages();
         break;
     case MQTT_EVENT_DATA:
         ESP_LOGI(TAG, "MQTT_EVENT_DATA");
@@ -58,6 +99,7 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         break;
     case MQTT_EVENT_ERROR:
         ESP_LOGI(TAG, "MQTT_EVENT_ERROR");
+        aug_metrics_add(AUG_METRICS_COUNTER_MQTT_ERRORS, 1);
         if (event->error_handle->error_type == MQTT_ERROR_TYPE_TCP_TRANSPORT) {
             log_error_if_nonzero("reported from esp-tls", event->error_handle->esp_tls_last_esp_err);
             log_error_if_nonzero("reported from tls stack", event->error_handle->esp_tls_stack_err);
@@ -90,25 +132,35 @@ esp_err_t aug_mqtt_deinit(void)
     AUG_RETURN_CHECK(esp_mqtt_client_destroy(mqtt_client_handle));
     mqtt_client_handle = NULL;
     is_connected = false;
+    is_started = false;
 
     return ESP_OK;
 }
 
 esp_err_t aug_mqtt_start(void)
 {
-    return esp_mqtt_client_start(mqtt_client_handle);
+    AUG_RETURN_CHECK(esp_mqtt_client_start(mqtt_client_handle));
+    is_started = true;
+    return ESP_OK;
 }
 
 esp_err_t aug_mqtt_stop(void)
 {
-    return esp_mqtt_client_stop(mqtt_client_handle);
+    AUG_RETURN_CHECK(esp_mqtt_client_stop(mqtt_client_handle));
+    is_started = false;
+    return ESP_OK;
 }
 
 esp_err_t aug_mqtt_set_uri(void)
 {
+    // The client that is not started yet connects to the new URI once it is started.
+    if (!is_started)
+        return esp_mqtt_client_set_uri(mqtt_client_handle, uri_str);
     AUG_RETURN_CHECK(esp_mqtt_client_stop(mqtt_client_handle));
+    is_started = false;
     AUG_RETURN_CHECK(esp_mqtt_client_set_uri(mqtt_client_handle, uri_str));
     AUG_RETURN_CHECK(esp_mqtt_client_start(mqtt_client_handle));
+    is_started = true;
 
     return ESP_OK;
 }
@@ -127,11 +179,54 @@ void aug_mqtt_set_default_uri(void)
     memcpy(uri_str, DEFAULT_MQTT_BROKER_URI, sizeof(DEFAULT_MQTT_BROKER_URI));
 }
 
+static esp_err_t enqueue(const char* topic, const char* data, size_t data_len, 
+    int qos, bool retain, int* msg_id)
+{
+    if (!mqtt_client_handle)
+        return ESP_ERR_INVALID_STATE;
+    *msg_id = esp_mqtt_client_enqueue(mqtt_client_handle, topic, data, data_len, qos, retain, true);
+    esp_err_t result = *msg_id == -2 ? ESP_ERR_NO_MEM : (*msg_id < 0 ? ESP_FAIL : ESP_OK);
+    aug_trace(AUG_TRACE_EVENT_MQTT_ENQUEUE, result, data_len);
+    return result;
+}
+
+esp_err_t aug_mqtt_publish(const char* topic, const char* data, size_t data_len, 
+    int qos, bool retain, size_t* outbox_size)
+{
+    int msg_id = -1;
+    esp_err_t result = enqueue(topic, data, data_len, qos, retain, &msg_id);
+    if (outbox_size)
+        *outbox_size = aug_mqtt_get_outbox_size();
+    return result;
+}
+
+esp_err_t aug_mqtt_publish_acked(const char* topic, const char* data, size_t data_len, int* msg_id)
+{
+    return enqueue(topic, data, data_len, 1, false, msg_id);
+}
+
 esp_err_t aug_mqtt_publish_str(const char* topic, const char* data)
 {
-    int msg_id = esp_mqtt_client_publish(mqtt_client_handle, topic, data, 0, 0, 0);
-    ESP_LOGI(TAG, "Sent publish successful, msg_id=%d, topic=%s, data=%s", msg_id, topic, data);
-    return ESP_OK;
+    return aug_mqtt_publish(topic, data, strlen(data), DEFAULT_PUBLISH_QOS, false, NULL);
+}
+
+size_t aug_mqtt_get_outbox_size(void)
+{
+    if (!mqtt_client_handle)
+        return 0;
+    int size = esp_mqtt_client_get_outbox_size(mqtt_client_handle);
+    return size > 0 ? size : 0;
+}
+
+void aug_mqtt_set_retained_messages(const aug_mqtt_message_t* messages, size_t messages_number)
+{
+    retained_messages = messages;
+    retained_messages_number = messages_number;
+}
+
+void aug_mqtt_set_published_callback(aug_mqtt_published_callback_t callback)
+{
+    published_callback = callback;
 }
 
 bool aug_mqtt_is_init(void)
@@ -146,6 +241,11 @@ bool aug_mqtt_is_connected(void)
     return is_connected;
 }
 
+bool aug_mqtt_is_started(void)
+{
+    return is_started;
+}
+
 esp_mqtt_client_config_t* aug_mqtt_get_config(void)
 {
     return &mqtt_config;
@@ -14,6 +14,7 @@ static const char wifi_ap_config_config_str[] = "config";
 
 static const char wifi_sta_config_namespace_str[] = "wifi_sta_config";
 static const char wifi_sta_config_config_str[] = "config";
+static const char wifi_sta_config_cache_str[] = "cache";
 
 static const char mqtt_config_namespace_str[] = "mqtt_config";
 static const char mqtt_config_config_str[] = "uri";
@@ -109,6 +110,20 @@ esp_err_t aug_nvs_set_sta_config(void)
         (const uint8_t*)sta_config, sizeof(*sta_config));
 }
 
+esp_err_t aug_nvs_get_sta_cache(void)
+{
+    aug_wifi_sta_cache_t* sta_cache = aug_wifi_sta_get_cache();
+    return get_blob(wifi_sta_config_namespace_str, wifi_sta_config_cache_str,
+        (uint8_t*)sta_cache, sizeof(*sta_cache));
+}
+
+esp_err_t aug_nvs_set_sta_cache(void)
+{
+    aug_wifi_sta_cache_t* sta_cache = aug_wifi_sta_get_cache();
+    return set_blob(wifi_sta_config_namespace_str, wifi_sta_config_cache_str,
+        (const uint8_t*)sta_cache, sizeof(*sta_cache));
+}
+
 esp_err_t aug_nvs_get_mqtt_config(void)
 {
     aug_mqtt_uri_t mqtt_uri = aug_mqtt_get_uri();
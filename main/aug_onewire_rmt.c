@@ -0,0 +1,130 @@
+#include "aug_onewire.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_log.h>
+
+#include "onewire_bus.h"
+#include "onewire_cmd.h"
+
+#include "aug_utility.h"
+
+#define DS18B20_CMD_CONVERT_TEMP 0x44
+#define DS18B20_CMD_WRITE_SCRATCHPAD 0x4E
+#define DS18B20_CMD_READ_SCRATCHPAD 0xBE
+
+static const char *TAG = "onewire rmt";
+
+typedef struct {
+    aug_onewire_bus_t base;
+    onewire_bus_handle_t handle;
+} rmt_bus_t;
+
+/**
+ * @brief Resets the bus and addresses the device with Match ROM or all devices with Skip ROM.
+ */
+static esp_err_t send_command(rmt_bus_t* bus, const uint64_t* address, uint8_t command)
+{
+    uint8_t tx_buffer[2 + sizeof(*address)] = {};
+    size_t tx_len = 0;
+
+    if (address) {
+        tx_buffer[tx_len++] = ONEWIRE_CMD_MATCH_ROM;
+        memcpy(&tx_buffer[tx_len], address, sizeof(*address));
+        tx_len += sizeof(*address);
+    }
+    else
+        tx_buffer[tx_len++] = ONEWIRE_CMD_SKIP_ROM;
+    tx_buffer[tx_len++] = command;
+
+    AUG_RETURN_CHECK(onewire_bus_reset(bus->handle));
+    return onewire_bus_write_bytes(bus->handle, tx_buffer, tx_len);
+}
+
+static esp_err_t rmt_search(aug_onewire_bus_t* base, uint64_t* addresses, size_t max, size_t* found)
+{
+    rmt_bus_t* bus = (rmt_bus_t*)base;
+    onewire_device_iter_handle_t iter = NULL;
+    onewire_device_t next_onewire_device;
+    esp_err_t search_result = ESP_OK;
+
+    *found = 0;
+    AUG_RETURN_CHECK(onewire_new_device_iter(bus->handle, &iter));
+    ESP_LOGI(TAG, "Device iterator created, start searching...");
+
+    do {
+        search_result = onewire_device_iter_get_next(iter, &next_onewire_device);
+        if (search_result != ESP_OK)
+            continue;
+        if ((next_onewire_device.address & 0xFF) != AUG_ONEWIRE_DS18B20_FAMILY_CODE) {
+            ESP_LOGI(TAG, "Found an unknown device, address: %016llX", next_onewire_device.address);
+            continue;
+        }
+        addresses[(*found)++] = next_onewire_device.address;
+        if (*found >= max) {
+            ESP_LOGI(TAG, "Max DS18B20 number reached, stop searching...");
+            break;
+        }
+    } while (search_result != ESP_ERR_NOT_FOUND);
+
+    return onewire_del_device_iter(iter);
+}
+
+static esp_err_t rmt_trigger_conversion(aug_onewire_bus_t* base, const uint64_t* address)
+{
+    return send_command((rmt_bus_t*)base, address, DS18B20_CMD_CONVERT_TEMP);
+}
+
+static esp_err_t rmt_read_scratchpad(aug_onewire_bus_t* base, uint64_t address, uint8_t* scratchpad)
+{
+    rmt_bus_t* bus = (rmt_bus_t*)base;
+    AUG_RETURN_CHECK(send_command(bus, &address, DS18B20_CMD_READ_SCRATCHPAD));
+    return onewire_bus_read_bytes(bus->handle, scratchpad, AUG_ONEWIRE_SCRATCHPAD_SIZE);
+}
+
+static esp_err_t rmt_write_scratchpad(aug_onewire_bus_t* base, uint64_t address, 
+    uint8_t th, uint8_t tl, uint8_t config)
+{
+    rmt_bus_t* bus = (rmt_bus_t*)base;
+    const uint8_t tx_buffer[] = { th, tl, config };
+    AUG_RETURN_CHECK(send_command(bus, &address, DS18B20_CMD_WRITE_SCRATCHPAD));
+    return onewire_bus_write_bytes(bus->handle, tx_buffer, sizeof(tx_buffer));
+}
+
+static esp_err_t rmt_del(aug_onewire_bus_t* base)
+{
+    rmt_bus_t* bus = (rmt_bus_t*)base;
+    esp_err_t result = onewire_bus_del(bus->handle);
+    free(bus);
+    return result;
+}
+
+esp_err_t aug_onewire_new_rmt_bus(int gpio, aug_onewire_bus_t** bus)
+{
+    onewire_bus_config_t bus_config = {
+        .bus_gpio_num = gpio,
+    };
+    onewire_bus_rmt_config_t rmt_config = {
+        .max_rx_bytes = 10, // 1byte ROM command + 8byte ROM number + 1byte device command
+    };
+    rmt_bus_t* rmt_bus = calloc(1, sizeof(*rmt_bus));
+    if (!rmt_bus)
+        return ESP_ERR_NO_MEM;
+
+    esp_err_t result = onewire_new_bus_rmt(&bus_config, &rmt_config, &rmt_bus->handle);
+    if (result != ESP_OK) {
+        free(rmt_bus);
+        return result;
+    }
+    rmt_bus->base = (aug_onewire_bus_t){
+        .search =               rmt_search,
+        .trigger_conversion =   rmt_trigger_conversion,
+        .read_scratchpad =      rmt_read_scratchpad,
+        .write_scratchpad =     rmt_write_scratchpad,
+        .del =                  rmt_del,
+    };
+    *bus = &rmt_bus->base;
+    ESP_LOGI(TAG, "1-Wire bus installed on GPIO%d", gpio);
+    return ESP_OK;
+}
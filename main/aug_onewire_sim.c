@@ -0,0 +1,251 @@
+#include "aug_onewire.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+#include <esp_random.h>
+#include <esp_timer.h>
+
+#include "aug_utility.h"
+
+/* Bus timings of the standard speed 1-Wire: reset with presence detection and a single time slot. */
+#define SIM_RESET_US 960
+#define SIM_SLOT_US 70
+#define SIM_SEARCH_SLOTS_PER_BIT 3
+/* Temperature register of the device that didn't finish any conversion yet, 85 Celsius. */
+#define SIM_POWER_ON_RAW 0x0550
+#define SIM_BASE_RAW (22 * 16)
+
+static const char *TAG = "onewire sim";
+
+typedef struct {
+    uint64_t address;
+    uint8_t th;
+    uint8_t tl;
+    uint8_t config;
+    int16_t raw;
+    int16_t converting_raw;
+    int64_t conversion_start_us;
+    bool is_converting;
+} sim_device_t;
+
+typedef struct {
+    aug_onewire_bus_t base;
+    int gpio;
+    sim_device_t* devices;
+    size_t devices_number;
+    uint32_t crc_error_rate;
+    uint32_t dropout_rate;
+    uint32_t owed_us;   // Bus time spent by the transactions but not waited yet
+} sim_bus_t;
+
+/**
+ * @brief Dallas/Maxim CRC-8 used by the ROM addresses and the scratchpad.
+ */
+static uint8_t sim_crc8(const uint8_t* data, size_t len)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; ++i) {
+        uint8_t byte = data[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            uint8_t mix = (crc ^ byte) & 0x01;
+            crc >>= 1;
+            if (mix)
+                crc ^= 0x8C;
+            byte >>= 1;
+        }
+    }
+    return crc;
+}
+
+static bool happens(uint32_t rate)
+{
+    return rate > 0 && esp_random() % 1000 < rate;
+}
+
+/**
+ * @brief Accounts the time the real bus would spend on the transaction. The time is waited 
+ *        with vTaskDelay in whole ticks once it adds up to a tick, so the core isn't kept busy 
+ *        and the rest is carried over to the next transaction.
+ * @param us Bus time of the transaction in microseconds.
+ */
+static void spend_bus_time(sim_bus_t* bus, uint32_t us)
+{
+    const uint32_t tick_us = portTICK_PERIOD_MS * 1000;
+    bus->owed_us += us;
+    if (bus->owed_us < tick_us)
+        return;
+    vTaskDelay(bus->owed_us / tick_us);
+    bus->owed_us %= tick_us;
+}
+
+/**
+ * @brief Returns the bus time of the transaction with the reset.
+ * @param bytes Number of bytes transferred after the reset.
+ */
+static uint32_t get_transaction_time_us(size_t bytes)
+{
+    return SIM_RESET_US + bytes * 8 * SIM_SLOT_US;
+}
+
+static uint32_t get_conversion_time_us(uint8_t config)
+{
+    // Resolution bits R1 R0 of the configuration register, the time doubles with every bit.
+    return 93750 << ((config >> 5) & 0x03);
+}
+
+static sim_device_t* find_device(sim_bus_t* bus, uint64_t address)
+{
+    for (size_t i = 0; i < bus->devices_number; ++i) {
+        if (bus->devices[i].address == address)
+            return &bus->devices[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief Finishes the conversion if enough time has passed for the configured resolution.
+ *        The register keeps the previous value until then, like the real device does.
+ */
+static void update_conversion(sim_device_t* device)
+{
+    if (!device->is_converting)
+        return;
+    if (esp_timer_get_time() - device->conversion_start_us < get_conversion_time_us(device->config))
+        return;
+    device->raw = device->converting_raw;
+    device->is_converting = false;
+}
+
+static void start_conversion(sim_device_t* device)
+{
+    update_conversion(device);
+    int16_t current = device->raw == SIM_POWER_ON_RAW ? device->converting_raw : device->raw;
+    // Random walk within one LSB of the 12-bit resolution.
+    device->converting_raw = current + (int16_t)(esp_random() % 3) - 1;
+    device->conversion_start_us = esp_timer_get_time();
+    device->is_converting = true;
+}
+
+static esp_err_t sim_search(aug_onewire_bus_t* base, uint64_t* addresses, size_t max, size_t* found)
+{
+    sim_bus_t* bus = (sim_bus_t*)base;
+    *found = 0;
+    for (size_t i = 0; i < bus->devices_number && *found < max; ++i) {
+        spend_bus_time(bus, SIM_RESET_US + (8 + 64 * SIM_SEARCH_SLOTS_PER_BIT) * SIM_SLOT_US);
+        addresses[(*found)++] = bus->devices[i].address;
+    }
+    ESP_LOGI(TAG, "Simulated search on GPIO %d found %u device(s)", bus->gpio, (unsigned)*found);
+    return ESP_OK;
+}
+
+static esp_err_t sim_trigger_conversion(aug_onewire_bus_t* base, const uint64_t* address)
+{
+    sim_bus_t* bus = (sim_bus_t*)base;
+    if (!address) {
+        spend_bus_time(bus, get_transaction_time_us(2));
+        for (size_t i = 0; i < bus->devices_number; ++i)
+            start_conversion(&bus->devices[i]);
+        return ESP_OK;
+    }
+    spend_bus_time(bus, get_transaction_time_us(10));
+    sim_device_t* device = find_device(bus, *address);
+    if (!device)
+        return ESP_ERR_NOT_FOUND;
+    start_conversion(device);
+    return ESP_OK;
+}
+
+static esp_err_t sim_read_scratchpad(aug_onewire_bus_t* base, uint64_t address, uint8_t* scratchpad)
+{
+    sim_bus_t* bus = (sim_bus_t*)base;
+    sim_device_t* device = find_device(bus, address);
+
+    spend_bus_time(bus, get_transaction_time_us(10 + AUG_ONEWIRE_SCRATCHPAD_SIZE));
+    // Nobody drives the bus low, so the master reads ones only.
+    if (!device || happens(bus->dropout_rate)) {
+        memset(scratchpad, 0xFF, AUG_ONEWIRE_SCRATCHPAD_SIZE);
+        return ESP_OK;
+    }
+    update_conversion(device);
+    scratchpad[0] = device->raw & 0xFF;
+    scratchpad[1] = (uint16_t)device->raw >> 8;
+    scratchpad[2] = device->th;
+    scratchpad[3] = device->tl;
+    scratchpad[4] = device->config;
+    scratchpad[5] = 0xFF;
+    scratchpad[6] = 0x0C;
+    scratchpad[7] = 0x10;
+    scratchpad[8] = sim_crc8(scratchpad, AUG_ONEWIRE_SCRATCHPAD_SIZE - 1);
+    if (happens(bus->crc_error_rate))
+        scratchpad[esp_random() % AUG_ONEWIRE_SCRATCHPAD_SIZE] ^= 1 << (esp_random() % 8);
+    return ESP_OK;
+}
+
+static esp_err_t sim_write_scratchpad(aug_onewire_bus_t* base, uint64_t address, 
+    uint8_t th, uint8_t tl, uint8_t config)
+{
+    sim_bus_t* bus = (sim_bus_t*)base;
+    sim_device_t* device = find_device(bus, address);
+
+    spend_bus_time(bus, get_transaction_time_us(10 + 3));
+    if (!device)
+        return ESP_ERR_NOT_FOUND;
+    device->th = th;
+    device->tl = tl;
+    device->config = config | 0x1F;
+    return ESP_OK;
+}
+
+static esp_err_t sim_del(aug_onewire_bus_t* base)
+{
+    sim_bus_t* bus = (sim_bus_t*)base;
+    free(bus->devices);
+    free(bus);
+    return ESP_OK;
+}
+
+esp_err_t aug_onewire_new_sim_bus(int gpio, size_t devices_number, uint32_t crc_error_rate, 
+    uint32_t dropout_rate, aug_onewire_bus_t** bus)
+{
+    sim_bus_t* sim_bus = calloc(1, sizeof(*sim_bus));
+    if (!sim_bus)
+        return ESP_ERR_NO_MEM;
+    sim_bus->devices = calloc(devices_number, sizeof(*sim_bus->devices));
+    if (!sim_bus->devices) {
+        free(sim_bus);
+        return ESP_ERR_NO_MEM;
+    }
+    sim_bus->gpio = gpio;
+    sim_bus->devices_number = devices_number;
+    sim_bus->crc_error_rate = crc_error_rate;
+    sim_bus->dropout_rate = dropout_rate;
+
+    // The serial number is made of the GPIO and the index, so every GPIO has its own devices across restarts.
+    for (size_t i = 0; i < devices_number; ++i) {
+        sim_device_t* device = &sim_bus->devices[i];
+        uint8_t rom[sizeof(device->address)] = { AUG_ONEWIRE_DS18B20_FAMILY_CODE };
+        rom[1] = i & 0xFF;
+        rom[2] = i >> 8;
+        rom[3] = gpio;
+        rom[7] = sim_crc8(rom, sizeof(rom) - 1);
+        memcpy(&device->address, rom, sizeof(rom));
+        device->config = 0x7F;
+        device->raw = SIM_POWER_ON_RAW;
+        device->converting_raw = SIM_BASE_RAW + gpio * 16 + i * 8;
+    }
+    sim_bus->base = (aug_onewire_bus_t){
+        .search =               sim_search,
+        .trigger_conversion =   sim_trigger_conversion,
+        .read_scratchpad =      sim_read_scratchpad,
+        .write_scratchpad =     sim_write_scratchpad,
+        .del =                  sim_del,
+    };
+    *bus = &sim_bus->base;
+    ESP_LOGI(TAG, "Simulated 1-Wire bus on GPIO %d with %u DS18B20 device(s) created", gpio, (unsigned)devices_number);
+    return ESP_OK;
+}
@@ -0,0 +1,295 @@
+#include "aug_ota.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <esp_timer.h>
+#include <esp_log.h>
+#include <esp_delta_ota.h>
+#include <mbedtls/sha256.h>
+
+#include "aug_utility.h"
+#include "aug_metrics.h"
+
+#define OTA_BUFFERS_NUMBER 2
+#define WRITER_TASK_STACK_SIZE (1024 * 3)
+/* The patcher decompresses heatshrink and calls back into esp_ota_write and SHA-256 from its own frames. */
+#define DELTA_WRITER_TASK_STACK_SIZE (1024 * 8)
+/* Free stack the writer keeps after every chunk, less means the stack size should be raised. */
+#define WRITER_TASK_STACK_MARGIN 512
+#define WRITER_TASK_PRIORITY 5
+
+static const char *TAG = "ota";
+
+/**
+ * @brief Chunk passed between the receiver and the writer, an empty chunk ends the image.
+ */
+typedef struct {
+    uint8_t* buffer;
+    size_t len;
+} chunk_t;
+
+static const esp_partition_t* ota_partition = NULL;
+static const esp_partition_t* running_partition = NULL;
+static esp_ota_handle_t ota_handle = 0;
+static esp_delta_ota_handle_t delta_handle = NULL;
+static mbedtls_sha256_context sha256_context;
+static uint8_t expected_sha256[AUG_OTA_SHA256_SIZE] = {};
+static uint8_t* buffers = NULL;
+/* Free buffers go to the receiver, filled ones to the writer. */
+static QueueHandle_t free_queue = NULL;
+static QueueHandle_t full_queue = NULL;
+static TaskHandle_t writer_task_handle = NULL;
+static TaskHandle_t waiting_task_handle = NULL;
+static volatile esp_err_t write_result = ESP_OK;
+static int64_t begin_time_us = 0;
+static aug_ota_stats_t stats = {};
+
+/**
+ * @brief Writes the part of the resulting image to flash and adds it to the SHA-256.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - others: refer to esp_ota_write
+ */
+static esp_err_t write_image(const uint8_t* buffer, size_t len)
+{
+    AUG_RETURN_CHECK(esp_ota_write(ota_handle, buffer, len));
+    mbedtls_sha256_update(&sha256_context, buffer, len);
+    stats.written += len;
+    aug_metrics_add(AUG_METRICS_COUNTER_OTA_BYTES, len);
+    return ESP_OK;
+}
+
+static int delta_read_callback(uint8_t* buffer, size_t size, int source_offset)
+{
+    return esp_partition_read(running_partition, source_offset, buffer, size) == ESP_OK ? 0 : -1;
+}
+
+static int delta_write_callback(const uint8_t* buffer, size_t size)
+{
+    return write_image(buffer, size) == ESP_OK ? 0 : -1;
+}
+
+static esp_err_t write_chunk(const chunk_t* chunk)
+{
+    if (stats.type == AUG_OTA_TYPE_DELTA)
+        return esp_delta_ota_feed_patch(delta_handle, chunk->buffer, chunk->len);
+    return write_image(chunk->buffer, chunk->len);
+}
+
+static void writer_task(void* params)
+{
+    (void)params;
+    chunk_t chunk;
+
+    while (xQueueReceive(full_queue, &chunk, portMAX_DELAY) == pdTRUE && chunk.len > 0) {
+        if (write_result == ESP_OK) {
+            int64_t start_us = esp_timer_get_time();
+            write_result = write_chunk(&chunk);
+            stats.write_ms += (esp_timer_get_time() - start_us) / 1000;
+            if (write_result != ESP_OK)
+                ESP_LOGI(TAG, "Failed to write the chunk: %s", esp_err_to_name(write_result));
+            const UBaseType_t stack_free = uxTaskGetStackHighWaterMark(NULL);
+            aug_metrics_set(AUG_METRICS_GAUGE_OTA_WRITER_STACK_FREE, stack_free);
+            assert(stack_free >= WRITER_TASK_STACK_MARGIN && "ota writer stack is too small");
+        }
+        xQueueSend(free_queue, &chunk.buffer, portMAX_DELAY);
+    }
+    xTaskNotifyGive(waiting_task_handle);
+    vTaskDelete(NULL);
+}
+
+static void free_resources(void)
+{
+    if (free_queue)
+        vQueueDelete(free_queue);
+    if (full_queue)
+        vQueueDelete(full_queue);
+    free(buffers);
+    if (delta_handle)
+        esp_delta_ota_deinit(delta_handle);
+    mbedtls_sha256_free(&sha256_context);
+    delta_handle = NULL;
+    free_queue = NULL;
+    full_queue = NULL;
+    buffers = NULL;
+    writer_task_handle = NULL;
+    stats.in_progress = false;
+}
+
+/**
+ * @brief Sends the end of the image to the writer and waits until it writes all queued chunks.
+ */
+static void stop_writer(void)
+{
+    const chunk_t end = {};
+    waiting_task_handle = xTaskGetCurrentTaskHandle();
+    xQueueSend(full_queue, &end, portMAX_DELAY);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+/**
+ * @brief Initializes the patcher that reads the running image and writes the patched one.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - ESP_FAIL: the patcher can't be initialized
+ */
+static esp_err_t begin_delta(void)
+{
+    running_partition = esp_ota_get_running_partition();
+    esp_delta_ota_cfg_t config = {
+        .read_cb = delta_read_callback,
+        .write_cb = delta_write_callback,
+    };
+    delta_handle = esp_delta_ota_init(&config);
+    return delta_handle ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t aug_ota_begin(size_t content_size, aug_ota_type_t type, const uint8_t* sha256)
+{
+    if (!sha256)
+        return ESP_ERR_INVALID_ARG;
+    if (stats.in_progress)
+        return ESP_ERR_INVALID_STATE;
+    ota_partition = esp_ota_get_next_update_partition(NULL);
+    if (!ota_partition)
+        return ESP_ERR_NOT_FOUND;
+    if (content_size == 0 || content_size > ota_partition->size)
+        return ESP_ERR_INVALID_SIZE;
+    ESP_LOGI(TAG, "Beginning %s update of %u bytes to %s", type == AUG_OTA_TYPE_DELTA ? "delta" : "full",
+        (unsigned)content_size, ota_partition->label);
+
+    stats = (aug_ota_stats_t) { .type = type, .content_size = content_size, .in_progress = true };
+    memcpy(expected_sha256, sha256, AUG_OTA_SHA256_SIZE);
+    mbedtls_sha256_init(&sha256_context);
+    mbedtls_sha256_starts(&sha256_context, 0);
+    begin_time_us = esp_timer_get_time();
+    write_result = ESP_OK;
+    buffers = malloc(OTA_BUFFERS_NUMBER * DEFAULT_OTA_CHUNK_SIZE);
+    free_queue = xQueueCreate(OTA_BUFFERS_NUMBER, sizeof(uint8_t*));
+    full_queue = xQueueCreate(OTA_BUFFERS_NUMBER + 1, sizeof(chunk_t));
+    if (!buffers || !free_queue || !full_queue) {
+        free_resources();
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t i = 0; i < OTA_BUFFERS_NUMBER; ++i) {
+        uint8_t* buffer = &buffers[i * DEFAULT_OTA_CHUNK_SIZE];
+        xQueueSend(free_queue, &buffer, 0);
+    }
+
+    // With the known size only the sectors of the image are erased, before the transfer starts.
+    esp_err_t result = esp_ota_begin(ota_partition, 
+        type == AUG_OTA_TYPE_DELTA ? OTA_SIZE_UNKNOWN : content_size, &ota_handle);
+    if (result != ESP_OK) {
+        free_resources();
+        return result;
+    }
+    if (type == AUG_OTA_TYPE_DELTA && begin_delta() != ESP_OK) {
+        esp_ota_abort(ota_handle);
+        free_resources();
+        return ESP_FAIL;
+    }
+    if (xTaskCreate(writer_task, "ota_writer_task", 
+            type == AUG_OTA_TYPE_DELTA ? DELTA_WRITER_TASK_STACK_SIZE : WRITER_TASK_STACK_SIZE,
+            NULL, WRITER_TASK_PRIORITY, &writer_task_handle) != pdPASS) {
+        esp_ota_abort(ota_handle);
+        free_resources();
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t aug_ota_get_buffer(uint8_t** buffer)
+{
+    int64_t start_us = esp_timer_get_time();
+    xQueueReceive(free_queue, buffer, portMAX_DELAY);
+    stats.receive_wait_ms += (esp_timer_get_time() - start_us) / 1000;
+    if (write_result != ESP_OK) {
+        xQueueSend(free_queue, buffer, portMAX_DELAY);
+        return write_result;
+    }
+    return ESP_OK;
+}
+
+esp_err_t aug_ota_submit(uint8_t* buffer, size_t len)
+{
+    if (len == 0 || stats.received + len > stats.content_size) {
+        xQueueSend(free_queue, &buffer, portMAX_DELAY);
+        return len == 0 ? ESP_OK : ESP_ERR_INVALID_SIZE;
+    }
+    // An empty chunk would end the image, so it is never queued.
+    const chunk_t chunk = { .buffer = buffer, .len = len };
+    stats.received += len;
+    xQueueSend(full_queue, &chunk, portMAX_DELAY);
+    return ESP_OK;
+}
+
+/**
+ * @brief Checks that the whole content is written and the image matches the expected SHA-256.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - ESP_ERR_INVALID_SIZE: the content is incomplete
+ *      - ESP_ERR_INVALID_CRC: the SHA-256 doesn't match
+ *      - others: refer to esp_delta_ota_finalize
+ */
+static esp_err_t verify_image(void)
+{
+    if (stats.received != stats.content_size)
+        return ESP_ERR_INVALID_SIZE;
+    if (stats.type == AUG_OTA_TYPE_DELTA)
+        AUG_RETURN_CHECK(esp_delta_ota_finalize(delta_handle));
+
+    uint8_t sha256[AUG_OTA_SHA256_SIZE] = {};
+    mbedtls_sha256_finish(&sha256_context, sha256);
+    if (memcmp(sha256, expected_sha256, sizeof(sha256)) != 0) {
+        ESP_LOGI(TAG, "SHA-256 of the image doesn't match");
+        return ESP_ERR_INVALID_CRC;
+    }
+    return ESP_OK;
+}
+
+esp_err_t aug_ota_end(void)
+{
+    stop_writer();
+    esp_err_t result = write_result;
+    if (result == ESP_OK)
+        result = verify_image();
+    if (result != ESP_OK) {
+        esp_ota_abort(ota_handle);
+        free_resources();
+        return result;
+    }
+    aug_ota_get_stats(&stats);
+    free_resources();
+    ESP_LOGI(TAG, "Image of %u bytes is written in %lu ms, %lu bytes/s",
+        (unsigned)stats.written, (unsigned long)stats.elapsed_ms, (unsigned long)stats.throughput);
+
+    AUG_RETURN_CHECK(esp_ota_end(ota_handle));
+    return esp_ota_set_boot_partition(ota_partition);
+}
+
+void aug_ota_abort(void)
+{
+    if (!stats.in_progress)
+        return;
+    ESP_LOGI(TAG, "Aborting update");
+    stop_writer();
+    esp_ota_abort(ota_handle);
+    free_resources();
+}
+
+void aug_ota_get_stats(aug_ota_stats_t* out)
+{
+    *out = stats;
+    if (!stats.in_progress)
+        return;
+    out->elapsed_ms = (esp_timer_get_time() - begin_time_us) / 1000;
+    if (out->elapsed_ms > 0)
+        out->throughput = (uint64_t)out->written * 1000 / out->elapsed_ms;
+}
@@ -0,0 +1,651 @@
+#include "aug_publisher.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <stdatomic.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <esp_mac.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include "aug_utility.h"
+#include "aug_mqtt_client.h"
+#include "aug_ds18b20.h"
+#include "aug_store.h"
+#include "aug_metrics.h"
+#include "aug_trace.h"
+#include "aug_task_stats.h"
+
+#define TOPIC_MAX_SIZE 80
+#define BATCH_VERSION 1
+#define BATCH_HEADER_SIZE 12
+#define BATCH_INVALID_READING INT16_MIN
+#define PUBLISH_TASK_STACK_SIZE (1024 * 4)
+#define PUBLISH_TASK_PRIORITY 5
+#define METRICS_BUFFER_SIZE (1024 * 6)
+#define BACKLOG_ACK_TIMEOUT_MS (1000 * 10)
+#define ACKED_MSG_IDS_NUM 8
+
+static_assert(AUG_DS18B20_MAX_SENSORS <= UINT8_MAX, "the sensor index should fit into a byte of the batch and the stored record");
+
+static const char *TAG = "publisher";
+
+/**
+ * @brief Report-by-exception state of a sensor.
+ */
+typedef struct {
+    int16_t last_centi_celsius;
+    int64_t last_publish_us;
+    bool has_last;
+} sensor_publish_state_t;
+
+/**
+ * @brief Topics of all sensor channels stored back to back 
+ *        with the fixed stride of TOPIC_MAX_SIZE, indexed by [sensor][channel].
+ */
+static char* topic_table = NULL;
+static char backlog_topic[TOPIC_MAX_SIZE] = {};
+static char readings_topic[TOPIC_MAX_SIZE] = {};
+static char metrics_topic[TOPIC_MAX_SIZE] = {};
+#if defined(CONFIG_TASK_PROFILING)
+static char tasks_topic[TOPIC_MAX_SIZE] = {};
+#endif
+static uint8_t device_mac[6] = {};
+static uint8_t* topic_lens = NULL;
+static size_t sensors_number = 0;
+static sensor_publish_state_t* publish_states = NULL;
+static uint32_t published_count = 0;
+static uint32_t suppressed_count = 0;
+static int64_t first_publish_us = 0;
+static char* metrics_buffer = NULL;
+static size_t metrics_len = 0;
+/* Buffers of the publish cycle, allocated once since they grow with the number of sensors 
+ * and the drain batch and wouldn't fit the stack of the publish task. */
+static aug_ds18b20_reading_t* cycle_readings = NULL;
+static bool* cycle_due = NULL;
+static bool* cycle_reported = NULL;
+static aug_store_record_t* drain_records = NULL;
+/* Backlog batch waiting for the broker acknowledgement, it stays in the store until then. */
+static size_t inflight_offset = 0;
+static size_t inflight_slots = 0;
+static TickType_t inflight_since = 0;
+static int inflight_msg_id = -1;
+/* Identifiers of the last acknowledged messages written by the MQTT client task. The batch can be 
+ * acknowledged before aug_mqtt_publish_acked returns its identifier, so it's looked up afterwards. */
+static atomic_int acked_msg_ids[ACKED_MSG_IDS_NUM];
+static atomic_uint acked_msg_ids_next = 0;
+/* The settings are changed by the HTTP server task, so they are copied under the lock. */
+static StaticSemaphore_t config_lock_buffer;
+static SemaphoreHandle_t config_lock = NULL;
+static aug_publisher_config_t publisher_config = {
+    .report_by_exception = DEFAULT_REPORT_BY_EXCEPTION,
+    .deadband = DEFAULT_DEADBAND,
+    .min_interval = DEFAULT_MIN_PUBLISH_INTERVAL,
+    .heartbeat_interval = DEFAULT_HEARTBEAT_INTERVAL,
+};
+
+static const char* const channel_suffixes[AUG_PUBLISHER_CHANNEL_NUM] = {
+    [AUG_PUBLISHER_CHANNEL_VALUE] =         "",
+    [AUG_PUBLISHER_CHANNEL_META_TYPE] =     "/meta/type",
+    [AUG_PUBLISHER_CHANNEL_META_READONLY] = "/meta/readonly",
+};
+
+#if defined(CONFIG_PAYLOAD_MODE_BINARY)
+static uint8_t* batch_payload = NULL;
+#else
+static aug_mqtt_message_t* meta_messages = NULL;
+static const char meta_type_str[] = "temperature";
+static const char meta_readonly_str[] = "1";
+#endif
+
+static uint8_t get_mac_hash() 
+{
+    esp_err_t ret;
+
+    ret = esp_base_mac_addr_get(device_mac);
+    if (ret != ESP_OK) {
+        ESP_LOGI(TAG, "Failed to get MAC address");
+        return 0;
+    }
+
+    uint8_t hash = 0;
+    for (int i = 0; i < sizeof(device_mac); i++) {
+        hash = hash * hash + device_mac[i];
+    }
+    return hash;
+}
+
+static size_t get_topic_offset(size_t index, aug_publisher_channel_t channel)
+{
+    return index * AUG_PUBLISHER_CHANNEL_NUM + channel;
+}
+
+/**
+ * @brief Renders topics for every sensor channel into the topic table and the device topics.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - ESP_ERR_NO_MEM: the table can't be allocated
+ *      - ESP_ERR_INVALID_SIZE: the topic doesn't fit the table entry
+ */
+static esp_err_t render_topic_table(void)
+{
+    uint8_t mac_hash = get_mac_hash();
+    size_t entries = sensors_number * AUG_PUBLISHER_CHANNEL_NUM;
+
+    topic_table = calloc(entries, TOPIC_MAX_SIZE);
+    topic_lens = calloc(entries, sizeof(*topic_lens));
+    if (!topic_table || !topic_lens) {
+        free(topic_table);
+        free(topic_lens);
+        topic_table = NULL;
+        topic_lens = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    int backlog_len = snprintf(backlog_topic, sizeof(backlog_topic), 
+        "/devices/rtl-esp-wroom%u/backlog", mac_hash);
+    if (backlog_len < 0 || backlog_len >= sizeof(backlog_topic))
+        return ESP_ERR_INVALID_SIZE;
+    int readings_topic_len = snprintf(readings_topic, sizeof(readings_topic), 
+        "/devices/rtl-esp-wroom%u/readings", mac_hash);
+    if (readings_topic_len < 0 || readings_topic_len >= sizeof(readings_topic))
+        return ESP_ERR_INVALID_SIZE;
+    int metrics_topic_len = snprintf(metrics_topic, sizeof(metrics_topic), 
+        "/devices/rtl-esp-wroom%u/metrics", mac_hash);
+    if (metrics_topic_len < 0 || metrics_topic_len >= sizeof(metrics_topic))
+        return ESP_ERR_INVALID_SIZE;
+#if defined(CONFIG_TASK_PROFILING)
+    int tasks_topic_len = snprintf(tasks_topic, sizeof(tasks_topic), 
+        "/devices/rtl-esp-wroom%u/tasks", mac_hash);
+    if (tasks_topic_len < 0 || tasks_topic_len >= sizeof(tasks_topic))
+        return ESP_ERR_INVALID_SIZE;
+#endif
+
+    for (size_t i = 0; i < sensors_number; ++i) {
+        for (int channel = 0; channel < AUG_PUBLISHER_CHANNEL_NUM; ++channel) {
+            size_t offset = get_topic_offset(i, channel);
+            int len = snprintf(&topic_table[offset * TOPIC_MAX_SIZE], TOPIC_MAX_SIZE,
+                "/devices/rtl-esp-wroom%u[%u]/controls/temperature%s", 
+                mac_hash, (unsigned)(i + 1), channel_suffixes[channel]);
+            if (len < 0 || len >= TOPIC_MAX_SIZE)
+                return ESP_ERR_INVALID_SIZE;
+            topic_lens[offset] = len;
+        }
+    }
+    return ESP_OK;
+}
+
+#if !defined(CONFIG_PAYLOAD_MODE_BINARY)
+/**
+ * @brief Registers meta topics of every sensor as retained messages of the MQTT client,
+ *        so they are published once per connection instead of every cycle.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - ESP_ERR_NO_MEM: the messages can't be allocated
+ */
+static esp_err_t register_meta_messages(void)
+{
+    const size_t meta_per_sensor = 2;
+    meta_messages = calloc(sensors_number * meta_per_sensor, sizeof(*meta_messages));
+    if (!meta_messages)
+        return ESP_ERR_NO_MEM;
+
+    for (size_t i = 0; i < sensors_number; ++i) {
+        meta_messages[i * meta_per_sensor] = (aug_mqtt_message_t){
+            .topic = aug_publisher_get_topic(i, AUG_PUBLISHER_CHANNEL_META_TYPE, NULL),
+            .data = meta_type_str,
+            .data_len = sizeof(meta_type_str) - 1,
+        };
+        meta_messages[i * meta_per_sensor + 1] = (aug_mqtt_message_t){
+            .topic = aug_publisher_get_topic(i, AUG_PUBLISHER_CHANNEL_META_READONLY, NULL),
+            .data = meta_readonly_str,
+            .data_len = sizeof(meta_readonly_str) - 1,
+        };
+    }
+    aug_mqtt_set_retained_messages(meta_messages, sensors_number * meta_per_sensor);
+    return ESP_OK;
+}
+#endif
+
+/**
+ * @brief Decides which readings of the sweep are reported.
+ *        Every valid reading is due unless the report-by-exception mode is enabled.
+ * @param readings Readings of the sweep.
+ * @param due Flags to store whether the reading of every sensor is due.
+ * @return size_t Number of due readings.
+ */
+static size_t select_due_readings(const aug_ds18b20_reading_t* readings, bool* due)
+{
+    aug_publisher_config_t config;
+    aug_publisher_get_config(&config);
+    const int64_t now = esp_timer_get_time();
+    size_t due_num = 0;
+
+    for (size_t i = 0; i < sensors_number; ++i) {
+        const sensor_publish_state_t* state = &publish_states[i];
+        due[i] = readings[i].valid;
+        if (due[i] && config.report_by_exception && state->has_last) {
+            int64_t elapsed_s = (now - state->last_publish_us) / 1000000;
+            int change = abs(aug_raw_temperature_to_centi(readings[i].raw) - state->last_centi_celsius);
+            due[i] = aug_is_report_due(change, elapsed_s, 
+                config.deadband, config.min_interval, config.heartbeat_interval);
+            if (!due[i])
+                ++suppressed_count;
+        }
+        due_num += due[i];
+    }
+    return due_num;
+}
+
+/**
+ * @brief Remembers the reported readings as the last reported ones.
+ * @param readings Readings of the sweep.
+ * @param reported Flags of the reported readings.
+ */
+static void commit_reported_readings(const aug_ds18b20_reading_t* readings, const bool* reported)
+{
+    const int64_t now = esp_timer_get_time();
+    for (size_t i = 0; i < sensors_number; ++i) {
+        if (!reported[i])
+            continue;
+        publish_states[i] = (sensor_publish_state_t) {
+            .last_centi_celsius = aug_raw_temperature_to_centi(readings[i].raw),
+            .last_publish_us = now,
+            .has_last = true,
+        };
+        ++published_count;
+    }
+}
+
+#if defined(CONFIG_PAYLOAD_MODE_BINARY)
+static void put_le16(uint8_t* buffer, uint16_t value)
+{
+    buffer[0] = value & 0xFF;
+    buffer[1] = value >> 8;
+}
+
+static void put_le32(uint8_t* buffer, uint32_t value)
+{
+    put_le16(buffer, value & 0xFFFF);
+    put_le16(buffer + 2, value >> 16);
+}
+
+/**
+ * @brief Packs readings of the sweep into the batch payload:
+ *        version, sensors number, MAC address and timestamp in seconds 
+ *        followed by little-endian centi-degrees of every sensor.
+ *        The timestamp is the system time synchronized by aug_wifi_sta, 
+ *        it counts seconds since boot until the first synchronization.
+ *        Invalid readings are marked with BATCH_INVALID_READING.
+ * @return size_t Length of the payload.
+ */
+static size_t pack_batch(const aug_ds18b20_reading_t* readings)
+{
+    batch_payload[0] = BATCH_VERSION;
+    batch_payload[1] = sensors_number;
+    memcpy(&batch_payload[2], device_mac, sizeof(device_mac));
+    put_le32(&batch_payload[8], time(NULL));
+    for (size_t i = 0; i < sensors_number; ++i) {
+        int16_t centi_celsius = readings[i].valid 
+            ? aug_raw_temperature_to_centi(readings[i].raw) : BATCH_INVALID_READING;
+        put_le16(&batch_payload[BATCH_HEADER_SIZE + i * sizeof(int16_t)], centi_celsius);
+    }
+    return BATCH_HEADER_SIZE + sensors_number * sizeof(int16_t);
+}
+
+/**
+ * @brief Publishes readings of all sensors in a single binary message.
+ *        The batch always carries every sensor, so it is published when any of them is due.
+ * @param readings Readings of the sweep.
+ * @param due Flags of the due readings.
+ * @param sent Flags to store whether the reading of every sensor is enqueued.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - ESP_ERR_NO_MEM: the outbox is over the limit
+ *      - others: refer to aug_mqtt_publish
+ */
+static esp_err_t publish_readings(const aug_ds18b20_reading_t* readings, const bool* due, bool* sent)
+{
+    size_t outbox_size = aug_mqtt_get_outbox_size();
+    if (outbox_size > DEFAULT_OUTBOX_LIMIT) {
+        aug_trace(AUG_TRACE_EVENT_PUBLISH_SKIPPED, 0, outbox_size);
+        return ESP_ERR_NO_MEM;
+    }
+    size_t len = pack_batch(readings);
+    esp_err_t result = aug_mqtt_publish(readings_topic, (const char*)batch_payload, len, 
+        DEFAULT_PUBLISH_QOS, false, NULL);
+    aug_metrics_add(result == ESP_OK ? AUG_METRICS_COUNTER_PUBLISHES : AUG_METRICS_COUNTER_PUBLISH_FAILURES, 1);
+    if (result != ESP_OK) {
+        aug_trace(AUG_TRACE_EVENT_PUBLISH_FAILED, sensors_number, result);
+        return result;
+    }
+    memcpy(sent, due, sensors_number * sizeof(*sent));
+    return ESP_OK;
+}
+#else
+/**
+ * @brief Publishes the value of every due reading while the outbox has room.
+ * @param readings Readings of the sweep.
+ * @param due Flags of the due readings.
+ * @param sent Flags to store whether the reading of every sensor is enqueued.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - ESP_ERR_NO_MEM: the outbox is over the limit, the rest of the readings are not sent
+ *      - others: the cycle is interrupted, refer to aug_mqtt_publish
+ */
+static esp_err_t publish_readings(const aug_ds18b20_reading_t* readings, const bool* due, bool* sent)
+{
+    char temperature_str[AUG_TEMPERATURE_STR_SIZE] = {};
+    size_t outbox_size = aug_mqtt_get_outbox_size();
+    for (size_t i = 0; i < sensors_number; ++i) {
+        if (!due[i])
+            continue;
+        if (outbox_size > DEFAULT_OUTBOX_LIMIT) {
+            aug_trace(AUG_TRACE_EVENT_PUBLISH_SKIPPED, i, outbox_size);
+            return ESP_ERR_NO_MEM;
+        }
+        size_t len = aug_raw_temperature_to_str(readings[i].raw, temperature_str, sizeof(temperature_str));
+        esp_err_t result = aug_mqtt_publish(aug_publisher_get_topic(i, AUG_PUBLISHER_CHANNEL_VALUE, NULL), 
+            temperature_str, len, DEFAULT_PUBLISH_QOS, false, &outbox_size);
+        aug_metrics_add(result == ESP_OK ? AUG_METRICS_COUNTER_PUBLISHES : AUG_METRICS_COUNTER_PUBLISH_FAILURES, 1);
+        if (result != ESP_OK) {
+            aug_trace(AUG_TRACE_EVENT_PUBLISH_FAILED, i, result);
+            return result;
+        }
+        sent[i] = true;
+    }
+    return ESP_OK;
+}
+#endif
+
+/**
+ * @brief Stores the due readings that are not reported yet and marks them as reported.
+ * @param readings Readings of the sweep.
+ * @param due Flags of the due readings.
+ * @param reported Flags of the reported readings, updated for the stored ones.
+ */
+static void store_readings(const aug_ds18b20_reading_t* readings, const bool* due, bool* reported)
+{
+    uint32_t timestamp = time(NULL);
+    for (size_t i = 0; i < sensors_number; ++i) {
+        if (!due[i] || reported[i])
+            continue;
+        esp_err_t result = aug_store_append(timestamp, i, aug_raw_temperature_to_centi(readings[i].raw));
+        if (result != ESP_OK)
+            ESP_LOGI(TAG, "Failed to store the reading: %s", esp_err_to_name(result));
+        reported[i] = result == ESP_OK;
+    }
+}
+
+static void handle_published(int msg_id)
+{
+    const unsigned next = atomic_load_explicit(&acked_msg_ids_next, memory_order_relaxed);
+    atomic_store_explicit(&acked_msg_ids[next % ACKED_MSG_IDS_NUM], msg_id, memory_order_relaxed);
+    atomic_store_explicit(&acked_msg_ids_next, next + 1, memory_order_relaxed);
+}
+
+static void clear_acked_msg_ids(void)
+{
+    for (size_t i = 0; i < ACKED_MSG_IDS_NUM; ++i)
+        atomic_store_explicit(&acked_msg_ids[i], -1, memory_order_relaxed);
+}
+
+static bool is_msg_acked(int msg_id)
+{
+    for (size_t i = 0; i < ACKED_MSG_IDS_NUM; ++i) {
+        if (atomic_load_explicit(&acked_msg_ids[i], memory_order_relaxed) == msg_id)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Consumes the backlog batch in flight from the store once the broker acknowledges it.
+ *        The batch is sent again if the acknowledgement doesn't come in BACKLOG_ACK_TIMEOUT_MS, 
+ *        e.g. when the outbox drops it after a reconnect.
+ * @return true If no batch is in flight, so the next one can be sent.
+ * @return false If the batch is still waiting for the acknowledgement.
+ */
+static bool settle_inflight_batch(void)
+{
+    if (inflight_slots == 0)
+        return true;
+    if (is_msg_acked(inflight_msg_id)) {
+        // The batch is gone already if the full store dropped its sector while it was in flight.
+        esp_err_t result = aug_store_consume(inflight_offset, inflight_slots);
+        if (result != ESP_OK)
+            ESP_LOGI(TAG, "Failed to consume the stored readings: %s", esp_err_to_name(result));
+        inflight_slots = 0;
+        return true;
+    }
+    if (xTaskGetTickCount() - inflight_since >= pdMS_TO_TICKS(BACKLOG_ACK_TIMEOUT_MS)) {
+        inflight_slots = 0;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Drains the stored readings to the broker one batch at a time 
+ *        until the store is empty or the publish period is over. 
+ *        A batch is consumed from the store only when the broker acknowledges it.
+ * @param cycle_start Tick count the current publish cycle started at.
+ * @param period Publish period in ticks.
+ */
+static void drain_store(TickType_t cycle_start, TickType_t period)
+{
+    const TickType_t interval = pdMS_TO_TICKS(DEFAULT_STORE_DRAIN_INTERVAL);
+
+    if (!aug_mqtt_is_connected() || aug_mqtt_get_outbox_size() > DEFAULT_OUTBOX_LIMIT)
+        return;
+    // Full pages are written on append, the partial page is written only right before draining.
+    if (aug_store_flush() != ESP_OK)
+        return;
+    while (!aug_store_is_empty() && aug_mqtt_is_connected()
+            && aug_mqtt_get_outbox_size() <= DEFAULT_OUTBOX_LIMIT
+            && xTaskGetTickCount() - cycle_start + interval < period) {
+        if (!settle_inflight_batch()) {
+            vTaskDelay(interval);
+            continue;
+        }
+        size_t slots = 0;
+        size_t offset = 0;
+        size_t count = aug_store_peek(drain_records, DEFAULT_STORE_DRAIN_BATCH, &slots, &offset);
+        if (slots == 0)
+            break;
+        if (count == 0) {
+            // Only corrupted records, nothing to wait for.
+            if (aug_store_consume(offset, slots) != ESP_OK)
+                break;
+            continue;
+        }
+        int msg_id = -1;
+        clear_acked_msg_ids();
+        if (aug_mqtt_publish_acked(backlog_topic, (const char*)drain_records, 
+                count * sizeof(*drain_records), &msg_id) != ESP_OK)
+            break;
+        inflight_msg_id = msg_id;
+        inflight_offset = offset;
+        inflight_slots = slots;
+        inflight_since = xTaskGetTickCount();
+        vTaskDelay(interval);
+    }
+}
+
+/**
+ * @brief Publishes the due readings and stores the ones that are not enqueued 
+ *        if the broker is unreachable or the outbox is full.
+ *        Reported readings become the reference for the deadband, 
+ *        the rest stay due for the next sweep.
+ * @param readings Readings of the sweep.
+ * @param due Flags of the due readings.
+ */
+static void report_readings(const aug_ds18b20_reading_t* readings, const bool* due)
+{
+    bool* reported = cycle_reported;
+    memset(reported, 0, sensors_number * sizeof(*reported));
+    esp_err_t result = ESP_ERR_INVALID_STATE;
+    if (aug_mqtt_is_connected())
+        result = publish_readings(readings, due, reported);
+    if (result == ESP_OK && first_publish_us == 0) {
+        first_publish_us = esp_timer_get_time();
+        aug_metrics_set(AUG_METRICS_GAUGE_FIRST_PUBLISH_MS, first_publish_us / 1000);
+        ESP_LOGI(TAG, "Time to first publish: %lu ms since boot", (unsigned long)(first_publish_us / 1000));
+    }
+    if (result != ESP_OK && aug_store_is_init())
+        store_readings(readings, due, reported);
+    commit_reported_readings(readings, reported);
+}
+
+static esp_err_t append_metrics(const char* data, size_t len, void* arg)
+{
+    (void)arg;
+    if (metrics_len + len > METRICS_BUFFER_SIZE)
+        return ESP_ERR_NO_MEM;
+    memcpy(&metrics_buffer[metrics_len], data, len);
+    metrics_len += len;
+    return ESP_OK;
+}
+
+/**
+ * @brief Publishes the metrics in the Prometheus text format if the metrics interval is over,
+ *        followed by the task report as JSON with CONFIG_TASK_PROFILING.
+ * @param last_publish_us Pointer to the time of the last metrics publish, updated on publish.
+ */
+static void publish_metrics(int64_t* last_publish_us)
+{
+    const int64_t now_us = esp_timer_get_time();
+    if (!metrics_buffer || !aug_mqtt_is_connected()
+            || now_us - *last_publish_us < (int64_t)DEFAULT_METRICS_PUBLISH_INTERVAL * 1000000)
+        return;
+    *last_publish_us = now_us;
+    metrics_len = 0;
+    esp_err_t result = aug_metrics_render(append_metrics, NULL);
+    if (result == ESP_OK)
+        result = aug_mqtt_publish(metrics_topic, metrics_buffer, metrics_len, 0, false, NULL);
+    if (result != ESP_OK)
+        ESP_LOGI(TAG, "Failed to publish the metrics: %s", esp_err_to_name(result));
+#if defined(CONFIG_TASK_PROFILING)
+    metrics_len = 0;
+    result = aug_task_stats_render(append_metrics, NULL);
+    if (result == ESP_OK)
+        result = aug_mqtt_publish(tasks_topic, metrics_buffer, metrics_len, 0, false, NULL);
+    if (result != ESP_OK)
+        ESP_LOGI(TAG, "Failed to publish the task report: %s", esp_err_to_name(result));
+#endif
+}
+
+/**
+ * @brief Returns the period of the publish cycle. In the report-by-exception mode 
+ *        every sweep of the sampler is checked, so changes are reported without waiting for the publish rate.
+ * @return TickType_t Period in ticks.
+ */
+static TickType_t get_cycle_period(void)
+{
+    aug_publisher_config_t config;
+    aug_publisher_get_config(&config);
+    if (config.report_by_exception)
+        return pdMS_TO_TICKS(DEFAULT_SAMPLE_RATE * 1000);
+    return pdMS_TO_TICKS(DEFAULT_PUBLISH_RATE * 1000);
+}
+
+static void publish_task(void* params)
+{
+    (void)params;
+    aug_ds18b20_reading_t* readings = cycle_readings;
+    bool* due = cycle_due;
+    uint32_t last_sweep = 0;
+    int64_t last_metrics_us = 0;
+    TickType_t cycle_start = xTaskGetTickCount();
+    
+    while (1) {
+        const TickType_t period = get_cycle_period();
+        const int64_t work_start_us = esp_timer_get_time();
+        uint32_t sweep = aug_ds18b20_get_readings(readings, sensors_number);
+        if (sweep != 0 && sweep != last_sweep) {
+            last_sweep = sweep;
+            if (select_due_readings(readings, due) > 0)
+                report_readings(readings, due);
+        }
+        if (aug_store_is_init())
+            drain_store(cycle_start, period);
+        aug_metrics_observe(AUG_METRICS_HISTOGRAM_PUBLISH_CYCLE_MS, (esp_timer_get_time() - work_start_us) / 1000);
+        aug_metrics_set(AUG_METRICS_GAUGE_MQTT_OUTBOX_BYTES, aug_mqtt_get_outbox_size());
+        aug_metrics_set(AUG_METRICS_GAUGE_PUBLISH_STACK_FREE, uxTaskGetStackHighWaterMark(NULL));
+        publish_metrics(&last_metrics_us);
+        vTaskDelayUntil(&cycle_start, period);
+    }
+}
+
+esp_err_t aug_publisher_start(void)
+{
+    ESP_LOGI(TAG, "Starting publisher");
+    config_lock = xSemaphoreCreateMutexStatic(&config_lock_buffer);
+    sensors_number = aug_get_sensors_number();
+    AUG_RETURN_CHECK(render_topic_table());
+    publish_states = calloc(sensors_number, sizeof(*publish_states));
+    cycle_readings = malloc(sensors_number * sizeof(*cycle_readings));
+    cycle_due = malloc(sensors_number * sizeof(*cycle_due));
+    cycle_reported = malloc(sensors_number * sizeof(*cycle_reported));
+    drain_records = malloc(DEFAULT_STORE_DRAIN_BATCH * sizeof(*drain_records));
+    if (!publish_states || !cycle_readings || !cycle_due || !cycle_reported || !drain_records)
+        return ESP_ERR_NO_MEM;
+#if defined(CONFIG_PAYLOAD_MODE_BINARY)
+    batch_payload = malloc(BATCH_HEADER_SIZE + sensors_number * sizeof(int16_t));
+    if (!batch_payload)
+        return ESP_ERR_NO_MEM;
+#else
+    AUG_RETURN_CHECK(register_meta_messages());
+#endif
+    aug_mqtt_set_published_callback(handle_published);
+    if (DEFAULT_METRICS_PUBLISH_INTERVAL > 0) {
+        metrics_buffer = malloc(METRICS_BUFFER_SIZE);
+        if (!metrics_buffer)
+            return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(publish_task, "publish_task", PUBLISH_TASK_STACK_SIZE, 
+            NULL, PUBLISH_TASK_PRIORITY, NULL) != pdPASS) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+const char* aug_publisher_get_topic(size_t index, aug_publisher_channel_t channel, size_t* topic_len)
+{
+    assert(topic_table && "publisher is not started");
+    size_t offset = get_topic_offset(index, channel);
+    if (topic_len)
+        *topic_len = topic_lens[offset];
+    return &topic_table[offset * TOPIC_MAX_SIZE];
+}
+
+void aug_publisher_get_config(aug_publisher_config_t* config)
+{
+    assert(config_lock && "publisher is not started");
+    xSemaphoreTake(config_lock, portMAX_DELAY);
+    *config = publisher_config;
+    xSemaphoreGive(config_lock);
+}
+
+void aug_publisher_set_config(const aug_publisher_config_t* config)
+{
+    assert(config_lock && "publisher is not started");
+    xSemaphoreTake(config_lock, portMAX_DELAY);
+    publisher_config = *config;
+    xSemaphoreGive(config_lock);
+}
+
+void aug_publisher_get_stats(uint32_t* published, uint32_t* suppressed)
+{
+    if (published)
+        *published = published_count;
+    if (suppressed)
+        *suppressed = suppressed_count;
+}
@@ -0,0 +1,271 @@
+#include "aug_store.h"
+
+#include <string.h>
+#include <assert.h>
+
+#include <esp_partition.h>
+#include <esp_rom_crc.h>
+#include <esp_log.h>
+#include <spi_flash_mmap.h>
+
+#include "aug_utility.h"
+
+#define STORE_PARTITION_SUBTYPE 0x40
+#define STORE_PARTITION_LABEL "readings"
+#define STORE_PAGE_SIZE 256
+#define STORE_SECTOR_SIZE SPI_FLASH_SEC_SIZE
+#define RECORD_SIZE sizeof(aug_store_record_t)
+#define RECORDS_PER_PAGE (STORE_PAGE_SIZE / RECORD_SIZE)
+
+static_assert(STORE_PAGE_SIZE % RECORD_SIZE == 0, "records should fill the page");
+static_assert(STORE_SECTOR_SIZE % STORE_PAGE_SIZE == 0, "pages should fill the sector");
+
+static const char *TAG = "store";
+
+static const esp_partition_t* partition = NULL;
+static size_t store_size = 0;
+/* Offset of the next page to write, always page-aligned. */
+static size_t head = 0;
+/* Offset of the oldest record that is not drained yet. */
+static size_t tail = 0;
+static aug_store_record_t page[RECORDS_PER_PAGE];
+static size_t page_records = 0;
+
+typedef enum {
+    SECTOR_EMPTY,
+    SECTOR_PARTIAL,
+    SECTOR_FULL,
+} sector_state_t;
+
+static uint8_t get_record_crc(const aug_store_record_t* record)
+{
+    return esp_rom_crc8_le(0, (const uint8_t*)record, offsetof(aug_store_record_t, crc));
+}
+
+static bool is_record_erased(const aug_store_record_t* record)
+{
+    const uint8_t* bytes = (const uint8_t*)record;
+    for (size_t i = 0; i < RECORD_SIZE; ++i) {
+        if (bytes[i] != 0xFF)
+            return false;
+    }
+    return true;
+}
+
+static size_t get_sector_start(size_t offset)
+{
+    return offset - offset % STORE_SECTOR_SIZE;
+}
+
+static size_t get_next_sector(size_t offset)
+{
+    return (get_sector_start(offset) + STORE_SECTOR_SIZE) % store_size;
+}
+
+/**
+ * @brief Checks whether the page is written. A written page always 
+ *        starts with a record, even if the rest of it is padding.
+ */
+static esp_err_t is_page_written(size_t offset, bool* written)
+{
+    aug_store_record_t record;
+    AUG_RETURN_CHECK(esp_partition_read(partition, offset, &record, sizeof(record)));
+    *written = !is_record_erased(&record);
+    return ESP_OK;
+}
+
+/**
+ * @brief Finds the first page that is not written in the sector.
+ * @param sector Offset of the sector.
+ * @param free_page Pointer to store the offset of the page, 
+ *        it's equal to the end of the sector if the sector is full.
+ * @param state Pointer to store the sector state.
+ */
+static esp_err_t scan_sector(size_t sector, size_t* free_page, sector_state_t* state)
+{
+    size_t offset = sector;
+    for (; offset < sector + STORE_SECTOR_SIZE; offset += STORE_PAGE_SIZE) {
+        bool written = false;
+        AUG_RETURN_CHECK(is_page_written(offset, &written));
+        if (!written)
+            break;
+    }
+    *free_page = offset;
+    if (offset == sector)
+        *state = SECTOR_EMPTY;
+    else if (offset == sector + STORE_SECTOR_SIZE)
+        *state = SECTOR_FULL;
+    else
+        *state = SECTOR_PARTIAL;
+    return ESP_OK;
+}
+
+/**
+ * @brief Restores the head and the tail after reboot. Written sectors always form 
+ *        a single run that ends with the head sector, drained sectors are erased.
+ */
+static esp_err_t recover_positions(void)
+{
+    const size_t sectors_number = store_size / STORE_SECTOR_SIZE;
+    sector_state_t states[sectors_number];
+    size_t free_pages[sectors_number];
+    size_t head_sector = sectors_number;
+
+    for (size_t i = 0; i < sectors_number; ++i)
+        AUG_RETURN_CHECK(scan_sector(i * STORE_SECTOR_SIZE, &free_pages[i], &states[i]));
+    for (size_t i = 0; i < sectors_number && head_sector == sectors_number; ++i) {
+        if (states[i] == SECTOR_PARTIAL)
+            head_sector = i;
+    }
+    for (size_t i = 0; i < sectors_number && head_sector == sectors_number; ++i) {
+        size_t prev = (i + sectors_number - 1) % sectors_number;
+        if (states[i] == SECTOR_EMPTY && states[prev] == SECTOR_FULL)
+            head_sector = i;
+    }
+    if (head_sector == sectors_number) {
+        // Either nothing is written or the order is lost, start over from the first sector.
+        head_sector = 0;
+        if (states[0] != SECTOR_EMPTY) {
+            ESP_LOGI(TAG, "Ring order can't be recovered, dropping the first sector");
+            AUG_RETURN_CHECK(esp_partition_erase_range(partition, 0, STORE_SECTOR_SIZE));
+            states[0] = SECTOR_EMPTY;
+            free_pages[0] = 0;
+        }
+    }
+    head = free_pages[head_sector];
+
+    tail = head_sector * STORE_SECTOR_SIZE;
+    for (size_t i = 1; i < sectors_number; ++i) {
+        size_t sector = (head_sector + i) % sectors_number;
+        if (states[sector] != SECTOR_EMPTY) {
+            tail = sector * STORE_SECTOR_SIZE;
+            break;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Erases the sector that the head is going to enter. 
+ *        If the ring is full the tail moves to the next sector, dropping the oldest records.
+ */
+static esp_err_t prepare_next_sector(void)
+{
+    size_t next_sector = get_next_sector(head);
+    if (tail != head && get_sector_start(tail) == next_sector) {
+        ESP_LOGI(TAG, "Store is full, dropping the oldest sector");
+        tail = get_next_sector(next_sector);
+    }
+    return esp_partition_erase_range(partition, next_sector, STORE_SECTOR_SIZE);
+}
+
+static esp_err_t write_page(void)
+{
+    // The next sector is erased before the last page of the sector is written, 
+    // so there is always a sector that is not full after a power loss.
+    if ((head + STORE_PAGE_SIZE) % STORE_SECTOR_SIZE == 0)
+        AUG_RETURN_CHECK(prepare_next_sector());
+
+    memset(&page[page_records], 0xFF, (RECORDS_PER_PAGE - page_records) * RECORD_SIZE);
+    esp_err_t result = esp_partition_write(partition, head, page, STORE_PAGE_SIZE);
+    page_records = 0;
+    head = (head + STORE_PAGE_SIZE) % store_size;
+    return result;
+}
+
+esp_err_t aug_store_init(void)
+{
+    ESP_LOGI(TAG, "Initializing store");
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, 
+        STORE_PARTITION_SUBTYPE, STORE_PARTITION_LABEL);
+    if (!partition) {
+        ESP_LOGI(TAG, "Partition %s is not found", STORE_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    store_size = get_sector_start(partition->size);
+    if (store_size < 2 * STORE_SECTOR_SIZE) {
+        partition = NULL;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    page_records = 0;
+    esp_err_t result = recover_positions();
+    if (result != ESP_OK) {
+        partition = NULL;
+        return result;
+    }
+    ESP_LOGI(TAG, "Store recovered, head: 0x%x, tail: 0x%x", (unsigned)head, (unsigned)tail);
+    return ESP_OK;
+}
+
+esp_err_t aug_store_append(uint32_t timestamp, uint8_t sensor_id, int16_t centi_celsius)
+{
+    assert(partition && "store is not initialized");
+    aug_store_record_t* record = &page[page_records++];
+    record->timestamp = timestamp;
+    record->centi_celsius = centi_celsius;
+    record->sensor_id = sensor_id;
+    record->crc = get_record_crc(record);
+
+    if (page_records == RECORDS_PER_PAGE)
+        return write_page();
+    return ESP_OK;
+}
+
+esp_err_t aug_store_flush(void)
+{
+    assert(partition && "store is not initialized");
+    if (page_records == 0)
+        return ESP_OK;
+    return write_page();
+}
+
+size_t aug_store_peek(aug_store_record_t* out, size_t n, size_t* slots, size_t* offset)
+{
+    assert(partition && "store is not initialized");
+    *offset = tail;
+    size_t available = (head + store_size - tail) % store_size / RECORD_SIZE;
+    size_t to_end = (store_size - tail) / RECORD_SIZE;
+    size_t count = n < available ? n : available;
+    count = count < to_end ? count : to_end;
+
+    *slots = 0;
+    if (count == 0 || esp_partition_read(partition, tail, out, count * RECORD_SIZE) != ESP_OK)
+        return 0;
+    *slots = count;
+
+    size_t valid = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (is_record_erased(&out[i]) || get_record_crc(&out[i]) != out[i].crc)
+            continue;
+        out[valid++] = out[i];
+    }
+    return valid;
+}
+
+esp_err_t aug_store_consume(size_t offset, size_t slots)
+{
+    assert(partition && "store is not initialized");
+    // The full ring dropped the oldest sector since the peek, the slots don't point to the peeked records anymore.
+    if (offset != tail)
+        return ESP_ERR_INVALID_STATE;
+    for (size_t i = 0; i < slots && tail != head; ++i) {
+        tail = (tail + RECORD_SIZE) % store_size;
+        if (tail % STORE_SECTOR_SIZE == 0) {
+            size_t drained_sector = (tail + store_size - STORE_SECTOR_SIZE) % store_size;
+            AUG_RETURN_CHECK(esp_partition_erase_range(partition, drained_sector, STORE_SECTOR_SIZE));
+        }
+    }
+    return ESP_OK;
+}
+
+bool aug_store_is_empty(void)
+{
+    return !partition || head == tail;
+}
+
+bool aug_store_is_init(void)
+{
+    if (partition)
+        return true;
+    return false;
+}
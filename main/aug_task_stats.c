@@ -0,0 +1,180 @@
+#include "aug_task_stats.h"
+
+#if defined(CONFIG_TASK_PROFILING)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <esp_log.h>
+
+#include "aug_utility.h"
+
+#define SAMPLER_TASK_STACK_SIZE (1024 * 2)
+#define SAMPLER_TASK_PRIORITY 1
+#define WINDOW_SAMPLES (DEFAULT_TASK_PROFILING_WINDOW / DEFAULT_TASK_PROFILING_PERIOD)
+/* The ring keeps one more snapshot than the window, the oldest one is the start of the window. */
+#define SNAPSHOTS_NUMBER (WINDOW_SAMPLES + 1)
+#define ENTRY_MAX_SIZE 192
+
+static const char *TAG = "task stats";
+
+typedef struct {
+    UBaseType_t number;
+    configRUN_TIME_COUNTER_TYPE runtime;
+} task_runtime_t;
+
+typedef struct {
+    configRUN_TIME_COUNTER_TYPE total_runtime;
+    size_t tasks_number;
+    task_runtime_t* tasks;
+} snapshot_t;
+
+static SemaphoreHandle_t lock = NULL;
+static TaskStatus_t* statuses = NULL;
+static size_t statuses_number = 0;
+static snapshot_t snapshots[SNAPSHOTS_NUMBER] = {};
+static task_runtime_t* snapshot_tasks = NULL;
+static uint32_t samples_number = 0;
+
+static const char* get_state_str(eTaskState state)
+{
+    switch (state) {
+        case eRunning:
+            return "running";
+        case eReady:
+            return "ready";
+        case eBlocked:
+            return "blocked";
+        case eSuspended:
+            return "suspended";
+        case eDeleted:
+            return "deleted";
+        default:
+            return "invalid";
+    }
+}
+
+/**
+ * @brief Returns the run time of the task in the snapshot.
+ * @return true If the task exists in the snapshot.
+ */
+static bool find_runtime(const snapshot_t* snapshot, UBaseType_t number, configRUN_TIME_COUNTER_TYPE* runtime)
+{
+    for (size_t i = 0; i < snapshot->tasks_number; ++i) {
+        if (snapshot->tasks[i].number == number) {
+            *runtime = snapshot->tasks[i].runtime;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Returns the CPU load of the task since the snapshot in percent of all cores,
+ *        tasks created after the snapshot are counted from their start.
+ */
+static float get_cpu_load(const snapshot_t* since, const snapshot_t* last, const TaskStatus_t* status)
+{
+    const configRUN_TIME_COUNTER_TYPE total = last->total_runtime - since->total_runtime;
+    if (total == 0)
+        return 0.0f;
+    configRUN_TIME_COUNTER_TYPE start = 0;
+    find_runtime(since, status->xTaskNumber, &start);
+    return 100.0f * (status->ulRunTimeCounter - start) / ((float)total * portNUM_PROCESSORS);
+}
+
+static void take_snapshot(snapshot_t* snapshot)
+{
+    configRUN_TIME_COUNTER_TYPE total_runtime = 0;
+    statuses_number = uxTaskGetSystemState(statuses, DEFAULT_TASK_PROFILING_MAX_TASKS, &total_runtime);
+    if (statuses_number == 0)
+        ESP_LOGE(TAG, "More than %d tasks, increase the max tasks", DEFAULT_TASK_PROFILING_MAX_TASKS);
+    snapshot->total_runtime = total_runtime;
+    snapshot->tasks_number = statuses_number;
+    for (size_t i = 0; i < statuses_number; ++i) {
+        snapshot->tasks[i].number = statuses[i].xTaskNumber;
+        snapshot->tasks[i].runtime = statuses[i].ulRunTimeCounter;
+    }
+}
+
+static void sampler_task(void* params)
+{
+    (void)params;
+    TickType_t last_wake_time = xTaskGetTickCount();
+    while (1) {
+        xSemaphoreTake(lock, portMAX_DELAY);
+        take_snapshot(&snapshots[samples_number % SNAPSHOTS_NUMBER]);
+        ++samples_number;
+        xSemaphoreGive(lock);
+        vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(DEFAULT_TASK_PROFILING_PERIOD * 1000));
+    }
+}
+
+esp_err_t aug_task_stats_start(void)
+{
+    if (lock)
+        return ESP_ERR_INVALID_STATE;
+    ESP_LOGI(TAG, "Starting task profiling with period %d s and window %d s",
+        DEFAULT_TASK_PROFILING_PERIOD, WINDOW_SAMPLES * DEFAULT_TASK_PROFILING_PERIOD);
+    statuses = calloc(DEFAULT_TASK_PROFILING_MAX_TASKS, sizeof(*statuses));
+    snapshot_tasks = calloc(SNAPSHOTS_NUMBER * DEFAULT_TASK_PROFILING_MAX_TASKS, sizeof(*snapshot_tasks));
+    lock = xSemaphoreCreateMutex();
+    if (!statuses || !snapshot_tasks || !lock)
+        return ESP_ERR_NO_MEM;
+    for (size_t i = 0; i < SNAPSHOTS_NUMBER; ++i)
+        snapshots[i].tasks = &snapshot_tasks[i * DEFAULT_TASK_PROFILING_MAX_TASKS];
+
+    if (xTaskCreate(sampler_task, "task_stats_task", SAMPLER_TASK_STACK_SIZE,
+            NULL, SAMPLER_TASK_PRIORITY, NULL) != pdPASS) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static int format_task(char* buffer, size_t buffer_size, size_t index,
+    const snapshot_t* previous, const snapshot_t* window_start, const snapshot_t* last)
+{
+    const TaskStatus_t* status = &statuses[index];
+    return snprintf(buffer, buffer_size,
+        "%s{\"name\":\"%s\",\"state\":\"%s\",\"priority\":%u,\"core\":%d,\"stack_free\":%lu,"
+        "\"cpu\":%.1f,\"cpu_window\":%.1f}",
+        index == 0 ? "" : ",", status->pcTaskName, get_state_str(status->eCurrentState),
+        (unsigned)status->uxCurrentPriority, status->xCoreID == tskNO_AFFINITY ? -1 : (int)status->xCoreID,
+        (unsigned long)status->usStackHighWaterMark,
+        get_cpu_load(previous, last, status), get_cpu_load(window_start, last, status));
+}
+
+esp_err_t aug_task_stats_render(aug_task_stats_write_t write, void* arg)
+{
+    if (!lock)
+        return ESP_ERR_INVALID_STATE;
+    char buffer[ENTRY_MAX_SIZE];
+    esp_err_t result = ESP_OK;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    const uint32_t samples = samples_number;
+    const uint32_t window_samples = samples > WINDOW_SAMPLES ? WINDOW_SAMPLES : (samples > 0 ? samples - 1 : 0);
+    const snapshot_t* last = &snapshots[(samples + SNAPSHOTS_NUMBER - 1) % SNAPSHOTS_NUMBER];
+    const snapshot_t* previous = &snapshots[(samples + SNAPSHOTS_NUMBER - (samples > 1 ? 2 : 1)) % SNAPSHOTS_NUMBER];
+    const snapshot_t* window_start = &snapshots[(samples + SNAPSHOTS_NUMBER - 1 - window_samples) % SNAPSHOTS_NUMBER];
+
+    int len = snprintf(buffer, sizeof(buffer), "{\"period_s\":%d,\"window_s\":%lu,\"tasks\":[",
+        DEFAULT_TASK_PROFILING_PERIOD, (unsigned long)(window_samples * DEFAULT_TASK_PROFILING_PERIOD));
+    result = write(buffer, len, arg);
+    for (size_t i = 0; i < statuses_number && samples > 0 && result == ESP_OK; ++i) {
+        len = format_task(buffer, sizeof(buffer), i, previous, window_start, last);
+        if (len < 0 || len >= sizeof(buffer))
+            result = ESP_ERR_INVALID_SIZE;
+        else
+            result = write(buffer, len, arg);
+    }
+    xSemaphoreGive(lock);
+    AUG_RETURN_CHECK(result);
+    return write("]}", 2, arg);
+}
+
+#endif
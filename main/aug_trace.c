@@ -0,0 +1,96 @@
+#include "aug_trace.h"
+
+#include <string.h>
+#include <stdatomic.h>
+#include <assert.h>
+
+#include <esp_timer.h>
+
+#include "aug_utility.h"
+
+#define TRACE_MASK (DEFAULT_TRACE_BUFFER_ENTRIES - 1)
+#define DUMP_CHUNK_ENTRIES 32
+
+static_assert((DEFAULT_TRACE_BUFFER_ENTRIES & TRACE_MASK) == 0, "the trace buffer entries should be a power of two");
+
+/**
+ * @brief Entry of the ring with the same layout as aug_trace_entry_t and the atomic sequence.
+ */
+typedef struct {
+    atomic_uint sequence;
+    uint32_t timestamp_us;
+    uint16_t event;
+    uint16_t arg0;
+    uint32_t arg1;
+} trace_slot_t;
+
+static_assert(sizeof(trace_slot_t) == sizeof(aug_trace_entry_t), "the slot should match the dump entry");
+
+static trace_slot_t ring[DEFAULT_TRACE_BUFFER_ENTRIES];
+static atomic_uint next_sequence = 0;
+
+void aug_trace(aug_trace_event_t event, uint16_t arg0, uint32_t arg1)
+{
+    const uint32_t sequence = atomic_fetch_add_explicit(&next_sequence, 1, memory_order_relaxed);
+    trace_slot_t* slot = &ring[sequence & TRACE_MASK];
+
+    // Readers skip the slot until the new sequence is published.
+    atomic_store_explicit(&slot->sequence, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->timestamp_us = (uint32_t)esp_timer_get_time();
+    slot->event = event;
+    slot->arg0 = arg0;
+    slot->arg1 = arg1;
+    atomic_store_explicit(&slot->sequence, sequence + 1, memory_order_release);
+}
+
+uint32_t aug_trace_pack_str(const char* str)
+{
+    uint32_t packed = 0;
+    for (int i = 0; i < 4 && str[i] != '\0'; ++i)
+        packed |= (uint32_t)(uint8_t)str[i] << (8 * i);
+    return packed;
+}
+
+/**
+ * @brief Copies the entry of the sequence, the sequence of the copy is 0 if the slot was overwritten.
+ */
+static void read_entry(uint32_t sequence, aug_trace_entry_t* entry)
+{
+    const trace_slot_t* slot = &ring[sequence & TRACE_MASK];
+    const uint32_t expected = sequence + 1;
+    *entry = (aug_trace_entry_t) {};
+    if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != expected)
+        return;
+    entry->timestamp_us = slot->timestamp_us;
+    entry->event = slot->event;
+    entry->arg0 = slot->arg0;
+    entry->arg1 = slot->arg1;
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) == expected)
+        entry->sequence = expected;
+}
+
+esp_err_t aug_trace_dump(aug_trace_write_t write, void* arg)
+{
+    const uint32_t end = atomic_load_explicit(&next_sequence, memory_order_relaxed);
+    const uint32_t start = end > DEFAULT_TRACE_BUFFER_ENTRIES ? end - DEFAULT_TRACE_BUFFER_ENTRIES : 0;
+    const aug_trace_dump_header_t header = {
+        .magic = AUG_TRACE_MAGIC,
+        .version = AUG_TRACE_VERSION,
+        .entry_size = sizeof(aug_trace_entry_t),
+        .entries_number = end - start,
+        .lost_entries = start,
+    };
+    AUG_RETURN_CHECK(write(&header, sizeof(header), arg));
+
+    aug_trace_entry_t entries[DUMP_CHUNK_ENTRIES];
+    uint32_t sequence = start;
+    while (sequence != end) {
+        size_t count = 0;
+        while (count < DUMP_CHUNK_ENTRIES && sequence != end)
+            read_entry(sequence++, &entries[count++]);
+        AUG_RETURN_CHECK(write(entries, count * sizeof(*entries), arg));
+    }
+    return ESP_OK;
+}
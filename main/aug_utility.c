@@ -2,6 +2,8 @@
 
 #include <string.h>
 
+#include "aug_trace.h"
+
 static const char                  AUG_AUTH_OPEN[] = "open";
 static const char                  AUG_AUTH_WEP[] = "wep";
 static const char                  AUG_AUTH_WPA_PSK[] = "wpa_psk";
@@ -70,7 +72,7 @@ esp_err_t aug_auth_mode_to_str(wifi_auth_mode_t auth_mode, char* buffer, size_t
     const size_t size_enum = sizeof(AUG_AUTH_MODES_ENUM) / sizeof(*AUG_AUTH_MODES_ENUM);
     for (size_t i = 0; i < size_enum; ++i) {
         if (AUG_AUTH_MODES_ENUM[i] == auth_mode) {
-            ESP_LOGI(TAG, "the %s was found, converting to str", AUG_AUTH_MODES_STR[i]);
+            aug_trace(AUG_TRACE_EVENT_MODE_TO_STR, 0, auth_mode);
             size_t mode_str_size = strlen(AUG_AUTH_MODES_STR[i]) + 1;//+1 for \0
             memcpy(buffer, AUG_AUTH_MODES_STR[i], mode_str_size);
             return ESP_OK;
@@ -101,7 +103,7 @@ esp_err_t aug_sae_mode_to_str(wifi_sae_pwe_method_t sae_mode, char* buffer, size
     const size_t size_enum = sizeof(AUG_SAE_MODES_ENUM) / sizeof(*AUG_SAE_MODES_ENUM);
     for (size_t i = 0; i < size_enum; ++i) {
         if (AUG_SAE_MODES_ENUM[i] == sae_mode) {
-            ESP_LOGI(TAG, "the %s was found, converting to str", AUG_SAE_MODES_STR[i]);
+            aug_trace(AUG_TRACE_EVENT_MODE_TO_STR, 1, sae_mode);
             size_t mode_str_size = strlen(AUG_SAE_MODES_STR[i]) + 1;//+1 for \0
             memcpy(buffer, AUG_SAE_MODES_STR[i], mode_str_size);
             return ESP_OK;
@@ -118,4 +120,95 @@ size_t aug_get_auth_mode_size()
 size_t aug_get_sae_mode_size()
 {
     return AUG_SAE_MODE_MAX_SIZE;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Converts the magnitude of 1/16 Celsius to hundredths rounding half to even
+ *        the same way as printf does for the exactly representable value.
+ */
+static uint32_t raw_magnitude_to_centi(uint32_t magnitude)
+{
+    uint32_t quarters = magnitude * 25;// 100 / 16 = 25 / 4
+    uint32_t centi = quarters / 4;
+    uint32_t remainder = quarters % 4;
+    if (remainder > 2 || (remainder == 2 && (centi & 1)))
+        ++centi;
+    return centi;
+}
+
+size_t aug_raw_temperature_to_str(int16_t raw, char* buffer, size_t buffer_size)
+{
+    char digits[AUG_TEMPERATURE_STR_SIZE];
+    size_t digits_len = 0;
+    uint32_t magnitude = raw < 0 ? -(int32_t)raw : raw;
+    uint32_t centi = raw_magnitude_to_centi(magnitude);
+
+    // Digits are produced from the least significant one, the point goes after two of them.
+    do {
+        if (digits_len == 2)
+            digits[digits_len++] = '.';
+        digits[digits_len++] = '0' + centi % 10;
+        centi /= 10;
+    } while (centi > 0 || digits_len < 4);
+
+    size_t len = digits_len + (raw < 0 ? 1 : 0);
+    if (len + 1 > buffer_size)
+        return 0;
+    size_t pos = 0;
+    if (raw < 0)
+        buffer[pos++] = '-';
+    while (digits_len > 0)
+        buffer[pos++] = digits[--digits_len];
+    buffer[pos] = '\0';
+    return len;
+}
+
+int16_t aug_raw_temperature_to_centi(int16_t raw)
+{
+    uint32_t magnitude = raw < 0 ? -(int32_t)raw : raw;
+    uint32_t centi = raw_magnitude_to_centi(magnitude);
+    if (raw < 0)
+        return centi > -(int32_t)INT16_MIN ? INT16_MIN : -(int32_t)centi;
+    return centi > INT16_MAX ? INT16_MAX : centi;
+}
+
+bool aug_is_report_due(int change, int64_t elapsed_s, int deadband, int min_interval, int heartbeat_interval)
+{
+    return elapsed_s >= min_interval && (change >= deadband || elapsed_s >= heartbeat_interval);
+}
+
+uint32_t aug_get_backoff_delay_ms(int retry, uint32_t base_ms, uint32_t max_ms, uint32_t random)
+{
+    uint32_t delay_ms = base_ms;
+    while (retry-- > 0 && delay_ms < max_ms)
+        delay_ms *= 2;
+    if (delay_ms > max_ms)
+        delay_ms = max_ms;
+    const uint32_t half = delay_ms / 2;
+    return half + (half > 0 ? random % (half + 1) : 0);
+}
+
+static int hex_digit_to_value(char digit)
+{
+    if (digit >= '0' && digit <= '9')
+        return digit - '0';
+    if (digit >= 'a' && digit <= 'f')
+        return digit - 'a' + 10;
+    if (digit >= 'A' && digit <= 'F')
+        return digit - 'A' + 10;
+    return -1;
+}
+
+esp_err_t aug_hex_to_bytes(const char* hex, size_t hex_len, uint8_t* bytes, size_t bytes_size)
+{
+    if (hex_len != bytes_size * 2)
+        return ESP_ERR_INVALID_SIZE;
+    for (size_t i = 0; i < bytes_size; ++i) {
+        int high = hex_digit_to_value(hex[i * 2]);
+        int low = hex_digit_to_value(hex[i * 2 + 1]);
+        if (high < 0 || low < 0)
+            return ESP_ERR_INVALID_ARG;
+        bytes[i] = (high << 4) | low;
+    }
+    return ESP_OK;
+}
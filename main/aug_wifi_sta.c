@@ -4,62 +4,173 @@
 #include <stdio.h>
 
 #include <freertos/FreeRTOS.h>
-#include <freertos/task.h>
-#include <freertos/event_groups.h>
 #include <esp_system.h>
 #include <esp_wifi.h>
 #include <esp_event.h>
+#include <esp_timer.h>
+#include <esp_random.h>
 #include <esp_log.h>
+#include <esp_sntp.h>
 
 #include "aug_utility.h"
+#include "aug_metrics.h"
 
-/* FreeRTOS event group to signal when we are connected*/
-static EventGroupHandle_t s_wifi_event_group;
-
-/* The event group allows multiple bits for each event, but we only care about two events:
- * - we are connected to the AP with an IP
- * - we failed to connect after the maximum amount of retries */
-#define WIFI_CONNECTED_BIT BIT0
-#define WIFI_FAIL_BIT      BIT1
 ESP_EVENT_DEFINE_BASE(AUG_WIFI_STA_EVENTS);
 
 static const char* TAG = "aug wifi sta mode";
 
+/**
+ * @brief States of the connection, changed only by the event handler and the retry timer.
+ */
+typedef enum {
+    STA_STATE_IDLE,
+    STA_STATE_CONNECTING,    // Waiting for the driver to connect and the IP to be assigned
+    STA_STATE_WAITING_RETRY, // Waiting for the retry timer after the failed attempt
+    STA_STATE_CONNECTED,
+    STA_STATE_FAILED,        // The maximum number of retries is exceeded
+} sta_state_t;
+
 static aug_wifi_sta_config_t sta_config = {};
+static aug_wifi_sta_cache_t sta_cache = {};
 static esp_netif_t* sta_netif = NULL;
 
 static esp_event_loop_handle_t* event_loop_handle = NULL;
 static esp_event_handler_instance_t instance_any_id;
 static esp_event_handler_instance_t instance_got_ip;
+static esp_timer_handle_t retry_timer = NULL;
 
+static volatile sta_state_t state = STA_STATE_IDLE;
 static int retry_num = 0;
+static bool is_fast_path = false;
+static int64_t connect_start_us = 0;
+
+static void post_event(int32_t event_id, const void* event_data, size_t event_data_size)
+{
+    if (event_loop_handle)
+        esp_event_post_to(*event_loop_handle, AUG_WIFI_STA_EVENTS, event_id, 
+            event_data, event_data_size, portMAX_DELAY);
+}
+
+static bool is_cache_usable(void)
+{
+    return DEFAULT_STA_FAST_RECONNECT && sta_cache.is_valid 
+        && memcmp(sta_cache.ssid, sta_config.wifi_config.sta.ssid, sizeof(sta_cache.ssid)) == 0;
+}
+
+/**
+ * @brief Invalidates the cached AP and connects with the scan. The invalidated cache is posted to be stored, 
+ *        so the next boot doesn't retry the stale AP, the connection with the scan stores the new one.
+ */
+static void fall_back_to_scan(void)
+{
+    ESP_LOGI(TAG, "Cached AP is unavailable, falling back to the full scan");
+    is_fast_path = false;
+    sta_cache.is_valid = false;
+    post_event(AUG_WIFI_STA_EVENT_CACHE_INVALIDATED, NULL, 0);
+    esp_wifi_set_config(WIFI_IF_STA, &sta_config.wifi_config);
+    state = STA_STATE_CONNECTING;
+    esp_wifi_connect();
+}
+
+/**
+ * @brief Stores the AP of the current connection to the cache.
+ * @return true If the cache is changed.
+ */
+static bool update_cache(void)
+{
+    wifi_ap_record_t ap_info = {};
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK)
+        return false;
+
+    aug_wifi_sta_cache_t cache = {};
+    memcpy(cache.ssid, sta_config.wifi_config.sta.ssid, sizeof(cache.ssid));
+    memcpy(cache.bssid, ap_info.bssid, sizeof(cache.bssid));
+    cache.channel = ap_info.primary;
+    cache.is_valid = true;
+    if (memcmp(&cache, &sta_cache, sizeof(cache)) == 0)
+        return false;
+    sta_cache = cache;
+    return true;
+}
+
+/**
+ * @brief Starts the SNTP client after the first connection, it keeps polling the server 
+ *        across reconnections and mode switches, so it is never stopped.
+ */
+static void start_sntp(void)
+{
+    if (sizeof(DEFAULT_SNTP_SERVER) == 1 || esp_sntp_enabled())
+        return;
+    ESP_LOGI(TAG, "Synchronizing the time with %s", DEFAULT_SNTP_SERVER);
+    esp_sntp_setoperatingmode(ESP_SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, DEFAULT_SNTP_SERVER);
+    esp_sntp_init();
+}
+
+static void retry_timer_callback(void* arg)
+{
+    (void)arg;
+    if (state != STA_STATE_WAITING_RETRY)
+        return;
+    ESP_LOGI(TAG, "Retrying to connect to the AP...");
+    state = STA_STATE_CONNECTING;
+    esp_wifi_connect();
+}
+
+static void handle_disconnected(void)
+{
+    if (state == STA_STATE_IDLE || state == STA_STATE_FAILED)
+        return;
+    if (state == STA_STATE_CONNECTED)
+        connect_start_us = esp_timer_get_time();
+    ESP_LOGI(TAG,"Connect to the AP fail");
+    // The failed fast path doesn't count as a retry.
+    if (is_fast_path) {
+        fall_back_to_scan();
+        return;
+    }
+    if (retry_num >= sta_config.max_retry) {
+        state = STA_STATE_FAILED;
+        retry_num = 0;
+        post_event(AUG_WIFI_STA_EVENT_FAILED_ATTEMPTS, NULL, 0);
+        return;
+    }
+    // Stations that lost the same AP don't retry in lockstep.
+    const uint32_t delay_ms = aug_get_backoff_delay_ms(retry_num, 
+        DEFAULT_STA_RETRY_BASE_DELAY, DEFAULT_STA_RETRY_MAX_DELAY, esp_random());
+    ++retry_num;
+    aug_metrics_add(AUG_METRICS_COUNTER_WIFI_RETRIES, 1);
+    state = STA_STATE_WAITING_RETRY;
+    ESP_LOGI(TAG, "Retry %d of %d in %lu ms", retry_num, sta_config.max_retry, (unsigned long)delay_ms);
+    esp_timer_start_once(retry_timer, (uint64_t)delay_ms * 1000);
+}
 
 static void event_handler(void* arg, esp_event_base_t event_base,
                                 int32_t event_id, void* event_data)
 {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         ESP_LOGI(TAG, "Trying to connect to the AP...");
+        state = STA_STATE_CONNECTING;
         esp_wifi_connect();
     } 
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (retry_num < sta_config.max_retry) {
-            ESP_LOGI(TAG, "Retrying to connect to the AP...");
-            esp_wifi_connect();
-            retry_num++;
-        } 
-        else {
-            ESP_ERROR_CHECK(esp_event_post_to(*event_loop_handle, AUG_WIFI_STA_EVENTS, 
-                AUG_WIFI_STA_EVENT_FAILED_ATTEMPTS, NULL, 0, portMAX_DELAY));
-            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-            retry_num = 0;
-        }
-        ESP_LOGI(TAG,"Connect to the AP fail");
+        handle_disconnected();
     } 
     else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "Got ip:" IPSTR, IP2STR(&event->ip_info.ip));
+        aug_wifi_sta_connected_event_t connected = {
+            .is_fast_path = is_fast_path,
+            .is_cache_updated = update_cache(),
+            .connect_time_ms = (esp_timer_get_time() - connect_start_us) / 1000,
+        };
+        ESP_LOGI(TAG, "Connected to ap SSID:%s in %lu ms%s", sta_config.wifi_config.sta.ssid,
+            (unsigned long)connected.connect_time_ms, is_fast_path ? " with the cached AP" : "");
         retry_num = 0;
-        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        state = STA_STATE_CONNECTED;
+        aug_metrics_add(AUG_METRICS_COUNTER_WIFI_CONNECTS, 1);
+        start_sntp();
+        post_event(AUG_WIFI_STA_EVENT_CONNECTED, &connected, sizeof(connected));
     }
 }
 
@@ -67,7 +178,18 @@ esp_err_t aug_wifi_sta_connect(esp_event_loop_handle_t* _event_loop_handle)
 {
     ESP_LOGI(TAG, "Initializing wifi-STA resources");
     event_loop_handle = _event_loop_handle;
-    wifi_config_t* wifi_config = &sta_config.wifi_config;
+    wifi_config_t wifi_config = sta_config.wifi_config;
+    retry_num = 0;
+    state = STA_STATE_IDLE;
+    connect_start_us = esp_timer_get_time();
+    // The cached AP is connected without the scan, the configuration itself is left unchanged.
+    // The address is still leased with DHCP, so the lease is renewed and can't conflict.
+    is_fast_path = is_cache_usable();
+    if (is_fast_path) {
+        memcpy(wifi_config.sta.bssid, sta_cache.bssid, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.bssid_set = true;
+        wifi_config.sta.channel = sta_cache.channel;
+    }
 
     sta_netif = esp_netif_create_default_wifi_sta();//esp_netif_destroy
     
@@ -75,7 +197,11 @@ esp_err_t aug_wifi_sta_connect(esp_event_loop_handle_t* _event_loop_handle)
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     AUG_RETURN_CHECK(esp_wifi_init(&cfg));//esp_wifi_deinit
 
-    s_wifi_event_group = xEventGroupCreate();//vEventGroupDelete
+    const esp_timer_create_args_t timer_args = {
+        .callback = retry_timer_callback,
+        .name = "sta_retry",
+    };
+    AUG_RETURN_CHECK(esp_timer_create(&timer_args, &retry_timer));//esp_timer_delete
     AUG_RETURN_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
                                                         ESP_EVENT_ANY_ID,
                                                         &event_handler,
@@ -88,44 +214,28 @@ esp_err_t aug_wifi_sta_connect(esp_event_loop_handle_t* _event_loop_handle)
                                                         &instance_got_ip));
 
     AUG_RETURN_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));//esp_wifi_restore
-    AUG_RETURN_CHECK(esp_wifi_set_config(WIFI_IF_STA, wifi_config));//esp_wifi_restore
+    AUG_RETURN_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));//esp_wifi_restore
     AUG_RETURN_CHECK(esp_wifi_start());//esp_wifi_stop
     
-    ESP_LOGI(TAG, "Waiting for connection");
-    /* Waiting until either the connection is established (WIFI_CONNECTED_BIT) or connection failed for the maximum
-     * number of re-tries (WIFI_FAIL_BIT). The bits are set by event_handler() (see above) */
-    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-            WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-            pdFALSE,
-            pdFALSE,
-            portMAX_DELAY);
-    if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(TAG, "Connected to ap SSID:%s password:%s",
-                 wifi_config->sta.ssid, wifi_config->sta.password);
-        return ESP_OK;
-    } 
-    else if (bits & WIFI_FAIL_BIT) {
-        ESP_LOGI(TAG, "Failed to connect to SSID:%s, password:%s",
-                 wifi_config->sta.ssid, wifi_config->sta.password);
-        return ESP_FAIL;
-    } 
-    else {
-        ESP_LOGE(TAG, "UNEXPECTED EVENT");
-        return ESP_FAIL;
-    }
+    // The result is posted as AUG_WIFI_STA_EVENT_CONNECTED or AUG_WIFI_STA_EVENT_FAILED_ATTEMPTS.
+    ESP_LOGI(TAG, "Connecting to SSID:%s in the background%s", wifi_config.sta.ssid,
+        is_fast_path ? " with the cached AP" : "");
+    return ESP_OK;
 }
 
 esp_err_t aug_wifi_sta_disconnect(void)
 {
     ESP_LOGI(TAG, "Deinitializing wifi-STA resources");
     event_loop_handle = NULL;
+    state = STA_STATE_IDLE;
     AUG_RETURN_CHECK(esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, instance_any_id));
     AUG_RETURN_CHECK(esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, instance_got_ip));
-    AUG_RETURN_CHECK(esp_wifi_restore());
-    if (s_wifi_event_group) {
-        vEventGroupDelete(s_wifi_event_group);
-        s_wifi_event_group = NULL;
+    if (retry_timer) {
+        esp_timer_stop(retry_timer);
+        esp_timer_delete(retry_timer);
+        retry_timer = NULL;
     }
+    AUG_RETURN_CHECK(esp_wifi_restore());
     AUG_RETURN_CHECK(esp_wifi_deinit());
     if (sta_netif) {
         esp_netif_destroy(sta_netif);
@@ -134,6 +244,16 @@ esp_err_t aug_wifi_sta_disconnect(void)
     return ESP_OK;
 }
 
+aug_wifi_sta_cache_t* aug_wifi_sta_get_cache(void)
+{
+    return &sta_cache;
+}
+
+bool aug_wifi_sta_is_connected(void)
+{
+    return state == STA_STATE_CONNECTED;
+}
+
 bool aug_wifi_sta_is_init(void)
 {
     if (sta_netif)
@@ -1,17 +1,62 @@
 /**
  * @file aug_ds18b20.h
- * @brief Finds connected sensors in the hardware setup 
- *        and retrieves the current temperature.
+ * @brief Finds connected sensors on every 1-Wire bus of the hardware setup 
+ *        and retrieves the current temperature. Sensors are indexed bus by bus.
  */
 
 #if !defined(AUG_DS18B20_H)
 #define AUG_DS18B20_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
 #include <esp_check.h>
 
+#include "aug_history.h"
+
+#define DEFAULT_SAMPLE_RATE CONFIG_SAMPLE_RATE
+/**
+ * @brief Maximum number of sensors on all buses, the sensor index is a single byte 
+ *        in the binary batch and in the stored records.
+ */
+#define AUG_DS18B20_MAX_SENSORS 255
+/**
+ * @brief Converts the raw temperature register in 1/16 Celsius to Celsius.
+ */
+#define AUG_DS18B20_RAW_TO_CELSIUS(raw) ((raw) / 16.0f)
+
+/**
+ * @brief Resolution of the sensor, the values match bits R1 R0 of the configuration register.
+ */
+typedef enum {
+    AUG_DS18B20_RESOLUTION_9B,
+    AUG_DS18B20_RESOLUTION_10B,
+    AUG_DS18B20_RESOLUTION_11B,
+    AUG_DS18B20_RESOLUTION_12B,
+} aug_ds18b20_resolution_t;
+
+/**
+ * @brief Single reading of the sensor taken by the sampler.
+ *        The temperature is kept as the raw register value in 1/16 Celsius.
+ */
+typedef struct {
+    int16_t raw;
+    int64_t timestamp_us;
+    uint32_t sequence;
+    bool valid;
+} aug_ds18b20_reading_t;
+
+/**
+ * @brief Callback called by the sampler task after every sweep is written to the snapshot.
+ *        It runs on the sampler task, so it should only hand the work over to another task.
+ * @param sweep Sequence number of the sweep.
+ * @param arg Argument passed to aug_ds18b20_set_sweep_callback.
+ */
+typedef void (*aug_ds18b20_sweep_callback_t)(uint32_t sweep, void* arg);
+
 /**
- * @brief Initializes the DS18B20 sensor driver, searches for sensors, and sets resolution.
+ * @brief Initializes the DS18B20 sensor driver, searches for sensors on every bus, and sets resolution.
  *        Initializes resources that should be cleaned up with aug_ds18b20_deinit.
  * @return esp_err_t
  *      - ESP_OK: Succeeds 
@@ -26,15 +71,121 @@ esp_err_t aug_ds18b20_init();
  */
 esp_err_t aug_ds18b20_deinit();
 /**
- * @brief Returns the number of found sensors.
+ * @brief Returns the number of found sensors on all buses.
  * @return size_t Number of found sensors.
  */
 size_t aug_get_sensors_number();
+/**
+ * @brief Returns the ROM address of the sensor found on the bus.
+ * @param index Sensor index.
+ * @return uint64_t ROM address of the sensor.
+ */
+uint64_t aug_ds18b20_get_address(size_t index);
 /**
  * @brief Returns the current temperature by the sensor index.
  * @param index Sensor index.
- * @return float Current temperature in Celsius. 
+ * @return float Current temperature in Celsius, NAN if the index is out of range. 
  */
 float aug_get_temperature(size_t index);
+/**
+ * @brief Starts the temperature conversion on all sensors of every bus at once,
+ *        waits a single conversion time and reads the sensors one after another.
+ *        Use aug_ds18b20_get_readings while the sampler is started.
+ * @param out Buffer to store the temperatures in Celsius, ordered by the sensor index.
+ * @param n Number of elements in the buffer. 
+ *        Only the first min(n, aug_get_sensors_number()) elements are written.
+ * @return esp_err_t
+ *      - ESP_OK: Succeeds 
+ *      - ESP_ERR_INVALID_STATE: The sampler is started and owns the buses
+ *      - others: Refer to error codes in esp_err.h
+ */
+esp_err_t aug_ds18b20_sample_all(float* out, size_t n);
+/**
+ * @brief Same as aug_ds18b20_sample_all, but returns the raw temperature registers.
+ * @param out Buffer to store the temperatures in 1/16 Celsius, ordered by the sensor index.
+ * @param n Number of elements in the buffer. 
+ *        Only the first min(n, aug_get_sensors_number()) elements are written.
+ * @return esp_err_t
+ *      - ESP_OK: Succeeds 
+ *      - ESP_ERR_INVALID_STATE: The sampler is started and owns the buses
+ *      - ESP_ERR_INVALID_CRC: The scratchpad of a sensor is corrupted
+ *      - others: Refer to error codes in esp_err.h
+ */
+esp_err_t aug_ds18b20_sample_all_raw(int16_t* out, size_t n);
+/**
+ * @brief Starts the sampler task that periodically samples all sensors 
+ *        and stores the readings in the snapshot and the history. Every bus after the first one
+ *        is converted and read by its own task concurrently with the sampler. Readers of the snapshot 
+ *        never touch the bus and never block the sampler.
+ * Allocates resources that should be freed with aug_ds18b20_stop_sampler.
+ * @param period_ms Sampling period in milliseconds.
+ * @return esp_err_t
+ *      - ESP_OK: Succeeds 
+ *      - others: Refer to error codes in esp_err.h
+ */
+esp_err_t aug_ds18b20_start_sampler(uint32_t period_ms);
+/**
+ * @brief Stops the sampler task started with aug_ds18b20_start_sampler.
+ *        Waits until the sampler finishes the current sweep and the bus tasks exit,
+ *        so it should not be called from the sweep callback.
+ * @return esp_err_t
+ *      - ESP_OK: Succeeds 
+ */
+esp_err_t aug_ds18b20_stop_sampler(void);
+/**
+ * @brief Copies a consistent snapshot of the latest readings without locking.
+ *        Can be called from any task.
+ * @param out Buffer to store the readings, ordered by the sensor index.
+ * @param n Number of elements in the buffer.
+ *        Only the first min(n, aug_get_sensors_number()) elements are written.
+ * @return uint32_t Sequence number of the sweep the snapshot belongs to, 0 if nothing was sampled yet.
+ */
+uint32_t aug_ds18b20_get_readings(aug_ds18b20_reading_t* out, size_t n);
+/**
+ * @brief Pins the resolution of the sensor and disables the adaptive resolution for it.
+ *        The configuration register is written before the next conversion of the sensor.
+ * @param index Sensor index.
+ * @param resolution Resolution of the sensor.
+ * @return esp_err_t
+ *      - ESP_OK: Succeeds 
+ *      - ESP_ERR_INVALID_ARG: The index or the resolution is out of range
+ */
+esp_err_t aug_ds18b20_set_resolution(size_t index, aug_ds18b20_resolution_t resolution);
+/**
+ * @brief Enables or disables the adaptive resolution of the sensor. 
+ *        The sampler picks the resolution and the sampling duty of adaptive sensors 
+ *        from the sampling period and the recent rate of change.
+ * @param index Sensor index.
+ * @param adaptive Whether the resolution is adaptive.
+ * @return esp_err_t
+ *      - ESP_OK: Succeeds 
+ *      - ESP_ERR_INVALID_ARG: The index is out of range
+ */
+esp_err_t aug_ds18b20_set_adaptive_resolution(size_t index, bool adaptive);
+/**
+ * @brief Returns the resolution the sensor is currently configured to.
+ * @param index Sensor index.
+ * @return aug_ds18b20_resolution_t Configured resolution.
+ */
+aug_ds18b20_resolution_t aug_ds18b20_get_resolution(size_t index);
+/**
+ * @brief Returns the rolling aggregates of the sensor over the window. 
+ *        The aggregates are maintained by the sampler, so the call never touches the bus 
+ *        and never rescans the history.
+ * @param index Sensor index.
+ * @param window Window of the aggregates.
+ * @param stats Pointer to store the aggregates.
+ * @return esp_err_t
+ *      - ESP_OK: Succeeds 
+ *      - ESP_ERR_INVALID_STATE: The sampler was never started
+ *      - ESP_ERR_INVALID_ARG: The index or the window is out of range
+ */
+esp_err_t aug_ds18b20_get_stats(size_t index, aug_history_window_t window, aug_history_stats_t* stats);
+/**
+ * @brief Sets the callback called after every sweep of the sampler, replacing the previous one.
+ * @param callback Callback to call, NULL to remove it.
+ * @param arg Argument passed to the callback.
+ */
+void aug_ds18b20_set_sweep_callback(aug_ds18b20_sweep_callback_t callback, void* arg);
 
 #endif
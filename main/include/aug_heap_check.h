@@ -0,0 +1,45 @@
+/**
+ * @file aug_heap_check.h
+ * @brief Checks the heap after every teardown of the Wi-Fi, HTTP server and MQTT modules.
+ *        The free heap after the warm-up teardowns is the baseline, every later teardown
+ *        should return to it, so a loss above the tolerance is reported as a leak.
+ *        The results are exported as metrics. The soak task repeats the STA, AP
+ *        and MQTT URI cycles through the module events.
+ *        Compiled only with CONFIG_HEAP_CHECK.
+ */
+
+#if !defined(AUG_HEAP_CHECK_H)
+#define AUG_HEAP_CHECK_H
+
+#include <esp_check.h>
+#include <esp_event.h>
+
+#if defined(CONFIG_HEAP_CHECK)
+#define DEFAULT_HEAP_CHECK_WARMUP_CYCLES CONFIG_HEAP_CHECK_WARMUP_CYCLES
+#define DEFAULT_HEAP_CHECK_TOLERANCE CONFIG_HEAP_CHECK_TOLERANCE
+#define DEFAULT_HEAP_SOAK_CYCLES CONFIG_HEAP_SOAK_CYCLES
+#define DEFAULT_HEAP_SOAK_INTERVAL CONFIG_HEAP_SOAK_INTERVAL
+
+/**
+ * @brief Samples the heap and compares it with the baseline. Must be called when
+ *        the modules are torn down, so the heap is in the same state every time.
+ * @param name Name of the cycle for the log.
+ * @return esp_err_t
+ *      - ESP_OK: the heap returned to the baseline
+ *      - ESP_ERR_NO_MEM: the free heap is below the baseline by more than the tolerance
+ *      - ESP_ERR_INVALID_STATE: the heap is corrupted
+ */
+esp_err_t aug_heap_check_cycle(const char* name);
+/**
+ * @brief Starts the task repeating STA to AP to STA switches and MQTT URI changes
+ *        DEFAULT_HEAP_SOAK_CYCLES times, the result is logged when it finishes.
+ *        Does nothing if the soak cycles are 0.
+ * @param event_loop_handle Loop receiving the module events.
+ * @return esp_err_t
+ *      - ESP_OK: succeed
+ *      - others: refer to error code esp_err.h
+ */
+esp_err_t aug_heap_check_start_soak(esp_event_loop_handle_t* event_loop_handle);
+#endif
+
+#endif
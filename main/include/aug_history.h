@@ -0,0 +1,83 @@
+/**
+ * @file aug_history.h
+ * @brief Keeps a ring of recent raw samples per sensor with rolling aggregates
+ *        over the fixed windows. Aggregates are updated on every sample,
+ *        so reading them never rescans the ring.
+ */
+
+#if !defined(AUG_HISTORY_H)
+#define AUG_HISTORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <esp_check.h>
+
+#define DEFAULT_HISTORY_MAX_SAMPLES CONFIG_HISTORY_MAX_SAMPLES
+
+/**
+ * @brief Windows the aggregates are kept for.
+ */
+typedef enum {
+    AUG_HISTORY_WINDOW_1M,
+    AUG_HISTORY_WINDOW_15M,
+    AUG_HISTORY_WINDOW_1H,
+    AUG_HISTORY_WINDOW_NUM,
+} aug_history_window_t;
+
+/**
+ * @brief Aggregates of the valid samples in the window.
+ */
+typedef struct {
+    float min;       // Minimum in Celsius
+    float max;       // Maximum in Celsius
+    float mean;      // Mean in Celsius
+    float variance;  // Population variance in Celsius squared
+    uint32_t count;  // Number of valid samples, the other fields are 0 if there are none
+} aug_history_stats_t;
+
+typedef struct aug_history aug_history_t;
+
+/**
+ * @brief Allocates the history for the sensors sampled with the period.
+ *        The ring holds one hour of samples, but no more than DEFAULT_HISTORY_MAX_SAMPLES,
+ *        longer windows are shortened to the ring size.
+ * Allocates resources that should be freed with aug_history_delete.
+ * @param sensors_number Number of sensors.
+ * @param period_ms Sampling period in milliseconds.
+ * @param history Pointer to store the created history.
+ * @return esp_err_t
+ *      - ESP_OK: succeed
+ *      - ESP_ERR_INVALID_ARG: the period is 0
+ *      - ESP_ERR_NO_MEM: the history can't be allocated
+ */
+esp_err_t aug_history_create(size_t sensors_number, uint32_t period_ms, aug_history_t** history);
+/**
+ * @brief Frees the history created with aug_history_create.
+ * @param history History to free, can be NULL.
+ */
+void aug_history_delete(aug_history_t* history);
+/**
+ * @brief Appends the sample of the sensor and updates the aggregates of every window.
+ *        Should be called once for every sample taken, the windows are counted in samples.
+ * @param history History to append to.
+ * @param index Sensor index.
+ * @param raw Temperature in 1/16 Celsius.
+ * @param valid Whether the sample is valid, invalid samples keep their place but are not aggregated.
+ */
+void aug_history_push(aug_history_t* history, size_t index, int16_t raw, bool valid);
+/**
+ * @brief Returns the aggregates of the sensor over the window.
+ * @param history History to read from.
+ * @param index Sensor index.
+ * @param window Window of the aggregates.
+ * @param stats Pointer to store the aggregates.
+ * @return esp_err_t
+ *      - ESP_OK: succeed
+ *      - ESP_ERR_INVALID_ARG: the index or the window is out of range
+ */
+esp_err_t aug_history_get_stats(aug_history_t* history, size_t index,
+    aug_history_window_t window, aug_history_stats_t* stats);
+
+#endif
@@ -0,0 +1,98 @@
+/**
+ * @file aug_metrics.h
+ * @brief Keeps runtime counters, gauges and fixed-bucket histograms in static atomics
+ *        and renders them in the Prometheus text format. Recording is a relaxed atomic
+ *        operation, so it can be done from any task on hot paths.
+ */
+
+#if !defined(AUG_METRICS_H)
+#define AUG_METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <esp_check.h>
+
+#define DEFAULT_METRICS_PUBLISH_INTERVAL CONFIG_METRICS_PUBLISH_INTERVAL
+
+/**
+ * @brief Monotonic counters.
+ */
+typedef enum {
+    AUG_METRICS_COUNTER_PUBLISHES,          // Messages with readings handed to the MQTT client
+    AUG_METRICS_COUNTER_PUBLISH_FAILURES,   // Messages with readings the MQTT client refused
+    AUG_METRICS_COUNTER_ONEWIRE_CRC_ERRORS, // Scratchpads with the wrong CRC
+    AUG_METRICS_COUNTER_ONEWIRE_ERRORS,     // Failed bus transactions
+    AUG_METRICS_COUNTER_MQTT_CONNECTS,
+    AUG_METRICS_COUNTER_MQTT_DISCONNECTS,
+    AUG_METRICS_COUNTER_MQTT_ERRORS,
+    AUG_METRICS_COUNTER_WIFI_CONNECTS,
+    AUG_METRICS_COUNTER_WIFI_RETRIES,
+    AUG_METRICS_COUNTER_OTA_BYTES,          // Bytes of images written to flash
+    AUG_METRICS_COUNTER_HEAP_CHECK_FAILURES, // Teardowns that leaked or corrupted the heap
+    AUG_METRICS_COUNTER_NUM,
+} aug_metrics_counter_t;
+
+/**
+ * @brief Gauges set by the modules, the heap and the uptime are read when the metrics are rendered.
+ */
+typedef enum {
+    AUG_METRICS_GAUGE_MQTT_OUTBOX_BYTES,
+    AUG_METRICS_GAUGE_PUBLISH_STACK_FREE,   // Stack high-water mark of the publishing task in bytes
+    AUG_METRICS_GAUGE_SAMPLER_STACK_FREE,   // Stack high-water mark of the sampling task in bytes
+    AUG_METRICS_GAUGE_HEAP_CYCLE_LOSS_BYTES, // Free heap lost since the baseline after the last teardown
+    AUG_METRICS_GAUGE_OTA_WRITER_STACK_FREE, // Stack high-water mark of the OTA writer task in bytes
+    AUG_METRICS_GAUGE_FIRST_PUBLISH_MS,     // Time from boot to the first published reading
+    AUG_METRICS_GAUGE_NUM,
+} aug_metrics_gauge_t;
+
+/**
+ * @brief Histograms with the fixed bucket bounds.
+ */
+typedef enum {
+    AUG_METRICS_HISTOGRAM_CONVERSION_MS,    // Conversion and reading of a sampling sweep
+    AUG_METRICS_HISTOGRAM_PUBLISH_CYCLE_MS, // Publishing and draining of a publish cycle
+    AUG_METRICS_HISTOGRAM_NUM,
+} aug_metrics_histogram_t;
+
+/**
+ * @brief Receives the rendered metrics piece by piece.
+ * @param data Rendered text, not null-terminated.
+ * @param len Length of the text.
+ * @param arg Argument passed to aug_metrics_render.
+ * @return esp_err_t
+ *      - ESP_OK: continue rendering
+ *      - others: stop rendering and return the error
+ */
+typedef esp_err_t (*aug_metrics_write_t)(const char* data, size_t len, void* arg);
+
+/**
+ * @brief Adds the value to the counter.
+ * @param counter Counter to add to.
+ * @param value Value to add.
+ */
+void aug_metrics_add(aug_metrics_counter_t counter, uint32_t value);
+/**
+ * @brief Sets the gauge.
+ * @param gauge Gauge to set.
+ * @param value New value.
+ */
+void aug_metrics_set(aug_metrics_gauge_t gauge, int32_t value);
+/**
+ * @brief Counts the value in its bucket of the histogram.
+ * @param histogram Histogram to count in.
+ * @param value Observed value.
+ */
+void aug_metrics_observe(aug_metrics_histogram_t histogram, uint32_t value);
+/**
+ * @brief Renders all metrics in the Prometheus text format.
+ *        Metrics are read one by one, so they may be recorded while rendering.
+ * @param write Callback receiving the text.
+ * @param arg Argument passed to the callback.
+ * @return esp_err_t
+ *      - ESP_OK: succeed
+ *      - others: returned by the callback
+ */
+esp_err_t aug_metrics_render(aug_metrics_write_t write, void* arg);
+
+#endif
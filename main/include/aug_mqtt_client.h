@@ -2,7 +2,7 @@
  * @file aug_mqtt_client.h
  * @brief Initializes mqtt client, connects to broker,
  *        publishes data with predefined quality of service.
- * @todo Make tests for multiple allocations-deallocations to check memleaks. 
+ * @see aug_heap_check.h for the memleak checks across the init and deinit cycles.
  */
 
 #if !defined(AUG_MQTT_CLIENT_H)
@@ -17,6 +17,8 @@
 #define MQTT_MAX_URI_LEN CONFIG_HTTPD_MAX_URI_LEN
 #define DEFAULT_MQTT_BROKER_URI CONFIG_BROKER_URI
 #define DEFAULT_PUBLISH_RATE CONFIG_PUBLISH_RATE
+#define DEFAULT_PUBLISH_QOS CONFIG_PUBLISH_QOS
+#define DEFAULT_OUTBOX_LIMIT CONFIG_OUTBOX_LIMIT
 
 /**
  * @brief Structure needed because the MQTT configuration structure
@@ -27,6 +29,21 @@ typedef struct {
     size_t uri_len;
 } aug_mqtt_uri_t;
 
+/**
+ * @brief Message published with the retain flag every time the client connects to the broker.
+ */
+typedef struct {
+    const char* topic;
+    const char* data;
+    size_t data_len;
+} aug_mqtt_message_t;
+
+/**
+ * @brief Callback called from the MQTT client task when the broker acknowledges a message.
+ * @param msg_id Message identifier returned by aug_mqtt_publish_acked.
+ */
+typedef void (*aug_mqtt_published_callback_t)(int msg_id);
+
 /**
  * @brief Initializes a MQTT client.
  * Allocates resources that should be freed with aug_mqtt_deinit.
@@ -58,7 +75,8 @@ esp_err_t aug_mqtt_start(void);
  */
 esp_err_t aug_mqtt_stop(void);
 /**
- * @brief Stops MQTT client, sets the MQTT broker URI and starts MQTT client. 
+ * @brief Sets the MQTT broker URI. The started MQTT client is stopped and started again, 
+ *        the client that is not started only takes the URI. 
  * @return esp_err_t 
  *      - ESP_OK: succeed 
  *      - others: refer to error code esp_err.h 
@@ -73,14 +91,62 @@ aug_mqtt_uri_t aug_mqtt_get_uri(void);
  * @brief Sets the default MQTT broker URI.
  */
 void aug_mqtt_set_default_uri(void);
+/**
+ * @brief Enqueues data to be published to the topic by the MQTT client task.
+ *        Doesn't block the caller on the socket.
+ * @param topic Topic string that should be null-terminated.
+ * @param data Data buffer.
+ * @param data_len Length of the data buffer.
+ * @param qos Quality of service level of the message.
+ * @param retain Retain flag of the message.
+ * @param outbox_size Pointer to store the outbox size in bytes after enqueuing, can be NULL.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - ESP_ERR_NO_MEM: the outbox is full 
+ *      - ESP_ERR_INVALID_STATE: the client is not initialized
+ *      - ESP_FAIL: the message can't be enqueued
+ */
+esp_err_t aug_mqtt_publish(const char* topic, const char* data, size_t data_len, 
+    int qos, bool retain, size_t* outbox_size);
+/**
+ * @brief Enqueues data to be published to the topic with QoS 1, 
+ *        the published callback is called with the message identifier when the broker acknowledges it.
+ * @param topic Topic string that should be null-terminated.
+ * @param data Data buffer.
+ * @param data_len Length of the data buffer.
+ * @param msg_id Pointer to store the message identifier.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - others: refer to aug_mqtt_publish
+ */
+esp_err_t aug_mqtt_publish_acked(const char* topic, const char* data, size_t data_len, int* msg_id);
 /**
  * @brief Publishes data to the topic with predefined qos in module.
  * @param topic Topic string that should be null-terminated.
  * @param data Data string that should be null-terminated.
  * @return esp_err_t 
  *      - ESP_OK: succeed 
+ *      - others: refer to aug_mqtt_publish 
  */
 esp_err_t aug_mqtt_publish_str(const char* topic, const char* data);
+/**
+ * @brief Returns the number of bytes waiting in the outbox of the MQTT client.
+ * @return size_t Outbox size in bytes, 0 if the client is not initialized.
+ */
+size_t aug_mqtt_get_outbox_size(void);
+/**
+ * @brief Sets messages that are published with the retain flag once 
+ *        after each connection to the broker. They are enqueued by the client task 
+ *        as the outbox drains below DEFAULT_OUTBOX_LIMIT.
+ * @param messages Array of messages that should stay valid while the module is used.
+ * @param messages_number Number of messages in the array.
+ */
+void aug_mqtt_set_retained_messages(const aug_mqtt_message_t* messages, size_t messages_number);
+/**
+ * @brief Sets the callback called when the broker acknowledges a message.
+ * @param callback Callback that should be short and non-blocking, NULL to unset it.
+ */
+void aug_mqtt_set_published_callback(aug_mqtt_published_callback_t callback);
 /**
  * @brief Returns the current state of this module.
  * @return true If the module is initialized.
@@ -93,6 +159,12 @@ bool aug_mqtt_is_init(void);
  * @return false If the MQTT client is not connected.
  */
 bool aug_mqtt_is_connected(void);
+/**
+ * @brief Returns whether the MQTT client is started, it keeps reconnecting to the broker until it is stopped.
+ * @return true If the MQTT client is started.
+ * @return false If the MQTT client is not started.
+ */
+bool aug_mqtt_is_started(void);
 /**
  * @brief Returns a pointer to the statically allocated the MQTT client configuration.
  * @return esp_mqtt_client_config_t* Pointer to statically allocated structure. 
@@ -44,6 +44,24 @@ esp_err_t aug_nvs_get_sta_config(void);
  */
 esp_err_t aug_nvs_set_sta_config(void);
 
+/**
+ * @brief Retrieves the cache of the last successful station connection stored in NVS memory
+ *        and assigns it to the statically allocated cache in the module.
+ * @return esp_err_t 
+ *      - ESP_OK: Success 
+ *      - Others: Refer to error codes in esp_err.h 
+ */
+esp_err_t aug_nvs_get_sta_cache(void);
+
+/**
+ * @brief Stores the cache of the last successful station connection from the statically allocated cache
+ *        in the module to the NVS memory.
+ * @return esp_err_t 
+ *      - ESP_OK: Success 
+ *      - Others: Refer to error codes in esp_err.h
+ */
+esp_err_t aug_nvs_set_sta_cache(void);
+
 /**
  * @brief Retrieves the MQTT client configuration stored in NVS memory
  *        and assigns it to the statically allocated configuration in the module.
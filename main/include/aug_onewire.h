@@ -0,0 +1,90 @@
+/**
+ * @file aug_onewire.h
+ * @brief Interface of the 1-Wire bus backends used by the DS18B20 module.
+ *        The backend performs complete bus transactions, so the same sensor logic
+ *        runs on the RMT driven bus and on the software simulated one.
+ */
+
+#if !defined(AUG_ONEWIRE_H)
+#define AUG_ONEWIRE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <esp_check.h>
+
+#define AUG_ONEWIRE_SCRATCHPAD_SIZE 9
+#define AUG_ONEWIRE_DS18B20_FAMILY_CODE 0x28
+
+typedef struct aug_onewire_bus aug_onewire_bus_t;
+
+/**
+ * @brief Operations of the 1-Wire bus backend. Every operation starts with the bus reset.
+ */
+struct aug_onewire_bus {
+    /**
+     * @brief Searches DS18B20 devices on the bus.
+     * @param bus Bus the operation is called on.
+     * @param addresses Buffer to store the ROM addresses of found devices.
+     * @param max Number of elements in the buffer.
+     * @param found Pointer to store the number of found devices.
+     */
+    esp_err_t (*search)(aug_onewire_bus_t* bus, uint64_t* addresses, size_t max, size_t* found);
+    /**
+     * @brief Starts the temperature conversion without waiting for it to finish.
+     * @param bus Bus the operation is called on.
+     * @param address Pointer to the ROM address of the device, NULL to address all devices with Skip ROM.
+     */
+    esp_err_t (*trigger_conversion)(aug_onewire_bus_t* bus, const uint64_t* address);
+    /**
+     * @brief Reads the scratchpad of the device without checking its CRC.
+     * @param bus Bus the operation is called on.
+     * @param address ROM address of the device.
+     * @param scratchpad Buffer of AUG_ONEWIRE_SCRATCHPAD_SIZE bytes to store the scratchpad.
+     */
+    esp_err_t (*read_scratchpad)(aug_onewire_bus_t* bus, uint64_t address, uint8_t* scratchpad);
+    /**
+     * @brief Writes the alarm registers and the configuration register of the device.
+     * @param bus Bus the operation is called on.
+     * @param address ROM address of the device.
+     * @param th High alarm register.
+     * @param tl Low alarm register.
+     * @param config Configuration register.
+     */
+    esp_err_t (*write_scratchpad)(aug_onewire_bus_t* bus, uint64_t address, 
+        uint8_t th, uint8_t tl, uint8_t config);
+    /**
+     * @brief Frees the bus and the backend resources.
+     * @param bus Bus the operation is called on.
+     */
+    esp_err_t (*del)(aug_onewire_bus_t* bus);
+};
+
+/**
+ * @brief Creates the bus backend driven by the RMT peripheral.
+ * Allocates resources that should be freed with the del operation.
+ * @param gpio GPIO number of the bus.
+ * @param bus Pointer to store the created bus.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - others: refer to error code esp_err.h
+ */
+esp_err_t aug_onewire_new_rmt_bus(int gpio, aug_onewire_bus_t** bus);
+/**
+ * @brief Creates the software simulated bus with virtual DS18B20 devices. It models ROM search 
+ *        and transaction times, conversion delays per resolution, CRC errors and device dropouts.
+ *        The devices are derived from the GPIO, so every simulated bus has its own addresses.
+ * Allocates resources that should be freed with the del operation.
+ * @param gpio GPIO number the bus is simulated for.
+ * @param devices_number Number of virtual devices.
+ * @param crc_error_rate Probability of the corrupted scratchpad in 1/1000.
+ * @param dropout_rate Probability of the device not responding in 1/1000.
+ * @param bus Pointer to store the created bus.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - others: refer to error code esp_err.h
+ */
+esp_err_t aug_onewire_new_sim_bus(int gpio, size_t devices_number, uint32_t crc_error_rate, 
+    uint32_t dropout_rate, aug_onewire_bus_t** bus);
+
+#endif
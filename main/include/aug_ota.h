@@ -0,0 +1,97 @@
+/**
+ * @file aug_ota.h
+ * @brief Writes the firmware image to the next OTA partition in a pipeline:
+ *        the caller receives the next chunk into one buffer while the writer task
+ *        writes the previous chunk from the other buffer to flash.
+ *        The content is either the full image or a delta patch against the running image.
+ */
+
+#if !defined(AUG_OTA_H)
+#define AUG_OTA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <esp_check.h>
+
+#define DEFAULT_OTA_CHUNK_SIZE CONFIG_OTA_CHUNK_SIZE
+#define AUG_OTA_SHA256_SIZE 32
+
+/**
+ * @brief Type of the update content.
+ */
+typedef enum {
+    AUG_OTA_TYPE_FULL,   // Full application image
+    AUG_OTA_TYPE_DELTA,  // Delta patch created with detools against the running image
+} aug_ota_type_t;
+
+/**
+ * @brief Progress of the current or the last update.
+ */
+typedef struct {
+    aug_ota_type_t type;
+    size_t content_size;      // Size of the image or the patch in bytes
+    size_t received;          // Bytes submitted to the writer
+    size_t written;           // Bytes of the image written to flash
+    uint32_t elapsed_ms;      // Time since the update began
+    uint32_t receive_wait_ms; // Time the receiver waited for a free buffer
+    uint32_t write_ms;        // Time the writer spent writing to flash
+    uint32_t throughput;      // Written bytes per second
+    bool in_progress;
+} aug_ota_stats_t;
+
+/**
+ * @brief Erases the next OTA partition for the image and starts the writer task.
+ *        The full image erases only the part of the partition it takes, 
+ *        the size of the image patched by the delta is unknown, so the whole partition is erased.
+ * Allocates resources that should be freed with aug_ota_end or aug_ota_abort.
+ * @param content_size Size of the image or the patch in bytes.
+ * @param type Type of the content.
+ * @param sha256 Expected SHA-256 of the resulting image checked before it is set as the boot partition.
+ * @return esp_err_t
+ *      - ESP_OK: succeed
+ *      - ESP_ERR_INVALID_ARG: the SHA-256 is NULL
+ *      - ESP_ERR_INVALID_STATE: the update is already in progress
+ *      - ESP_ERR_INVALID_SIZE: the content doesn't fit the partition
+ *      - others: refer to error code esp_err.h
+ */
+esp_err_t aug_ota_begin(size_t content_size, aug_ota_type_t type, const uint8_t* sha256);
+/**
+ * @brief Returns the buffer to receive the next chunk into,
+ *        waits while the writer holds both buffers.
+ * @param buffer Pointer to store the buffer of DEFAULT_OTA_CHUNK_SIZE bytes.
+ * @return esp_err_t
+ *      - ESP_OK: succeed
+ *      - others: writing of a previous chunk failed, refer to esp_ota_write and esp_delta_ota_feed_patch
+ */
+esp_err_t aug_ota_get_buffer(uint8_t** buffer);
+/**
+ * @brief Hands the filled buffer over to the writer task.
+ * @param buffer Buffer returned by aug_ota_get_buffer.
+ * @param len Number of bytes in the buffer.
+ * @return esp_err_t
+ *      - ESP_OK: succeed
+ *      - ESP_ERR_INVALID_SIZE: the content is larger than announced in aug_ota_begin
+ */
+esp_err_t aug_ota_submit(uint8_t* buffer, size_t len);
+/**
+ * @brief Waits for the writer, validates the image and sets it as the boot partition.
+ *        Frees resources allocated with aug_ota_begin.
+ * @return esp_err_t
+ *      - ESP_OK: succeed
+ *      - ESP_ERR_INVALID_CRC: the SHA-256 of the image doesn't match the expected one
+ *      - others: refer to esp_ota_end and esp_ota_set_boot_partition
+ */
+esp_err_t aug_ota_end(void);
+/**
+ * @brief Stops the update, frees resources allocated with aug_ota_begin.
+ */
+void aug_ota_abort(void);
+/**
+ * @brief Returns the progress of the current or the last update.
+ * @param stats Pointer to store the progress.
+ */
+void aug_ota_get_stats(aug_ota_stats_t* stats);
+
+#endif
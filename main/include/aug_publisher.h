@@ -0,0 +1,85 @@
+/**
+ * @file aug_publisher.h
+ * @brief Publishes the sensor readings to the MQTT broker 
+ *        using the topics rendered once at startup.
+ */
+
+#if !defined(AUG_PUBLISHER_H)
+#define AUG_PUBLISHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <esp_check.h>
+
+#if defined(CONFIG_REPORT_BY_EXCEPTION)
+#define DEFAULT_REPORT_BY_EXCEPTION true
+#else
+#define DEFAULT_REPORT_BY_EXCEPTION false
+#endif
+#define DEFAULT_DEADBAND CONFIG_DEADBAND
+#define DEFAULT_MIN_PUBLISH_INTERVAL CONFIG_MIN_PUBLISH_INTERVAL
+#define DEFAULT_HEARTBEAT_INTERVAL CONFIG_HEARTBEAT_INTERVAL
+
+/**
+ * @brief Channels published for every sensor.
+ */
+typedef enum {
+    AUG_PUBLISHER_CHANNEL_VALUE,
+    AUG_PUBLISHER_CHANNEL_META_TYPE,
+    AUG_PUBLISHER_CHANNEL_META_READONLY,
+    AUG_PUBLISHER_CHANNEL_NUM,
+} aug_publisher_channel_t;
+
+/**
+ * @brief Report-by-exception settings. A reading is published when it moved 
+ *        by the deadband since the last published one, but not more often than 
+ *        the minimum interval, and at least once per the heartbeat interval.
+ */
+typedef struct {
+    int report_by_exception;  // Non-zero enables the report-by-exception mode
+    int deadband;             // Deadband in 1/100 Celsius
+    int min_interval;         // Minimum interval between publishes of a sensor in seconds
+    int heartbeat_interval;   // Maximum interval between publishes of a sensor in seconds
+} aug_publisher_config_t;
+
+/**
+ * @brief Renders the topic table for all found sensors, registers meta topics 
+ *        as retained MQTT messages and starts the publishing task.
+ *        The DS18B20 module should be initialized before, 
+ *        the MQTT client should be started after.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - others: refer to error code esp_err.h
+ */
+esp_err_t aug_publisher_start(void);
+/**
+ * @brief Returns the rendered topic of the sensor channel.
+ * @param index Sensor index.
+ * @param channel Channel of the sensor.
+ * @param topic_len Pointer to store the topic length without null-terminator, can be NULL.
+ * @return const char* Null-terminated topic string.
+ */
+const char* aug_publisher_get_topic(size_t index, aug_publisher_channel_t channel, size_t* topic_len);
+
+/**
+ * @brief Copies the report-by-exception settings. 
+ *        The publisher should be started before.
+ * @param config Pointer to store the settings.
+ */
+void aug_publisher_get_config(aug_publisher_config_t* config);
+/**
+ * @brief Replaces the report-by-exception settings as a whole, 
+ *        they are applied from the next publish cycle. The publisher should be started before.
+ * @param config Settings to copy.
+ */
+void aug_publisher_set_config(const aug_publisher_config_t* config);
+/**
+ * @brief Returns the number of readings published and suppressed by the deadband since the start.
+ * @param published Pointer to store the number of published readings, can be NULL.
+ * @param suppressed Pointer to store the number of suppressed readings, can be NULL.
+ */
+void aug_publisher_get_stats(uint32_t* published, uint32_t* suppressed);
+
+#endif
@@ -0,0 +1,92 @@
+/**
+ * @file aug_store.h
+ * @brief Keeps readings taken while the MQTT client is disconnected 
+ *        in an append-only ring log on the dedicated data partition.
+ * @note Records are written in page-sized batches. Records are consumed only after 
+ *       the broker acknowledges them and after a reboot the partially drained sector 
+ *       is drained again, so records are delivered at least once.
+ */
+
+#if !defined(AUG_STORE_H)
+#define AUG_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <esp_check.h>
+
+#define DEFAULT_STORE_DRAIN_BATCH CONFIG_STORE_DRAIN_BATCH
+#define DEFAULT_STORE_DRAIN_INTERVAL CONFIG_STORE_DRAIN_INTERVAL
+
+/**
+ * @brief Compact record of the reading as it is stored in flash and drained to the broker.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t timestamp;
+    int16_t centi_celsius;
+    uint8_t sensor_id;
+    uint8_t crc;
+} aug_store_record_t;
+
+/**
+ * @brief Finds the data partition and recovers the ring positions from its content.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - ESP_ERR_NOT_FOUND: the partition is not found
+ *      - others: refer to error code esp_err.h
+ */
+esp_err_t aug_store_init(void);
+/**
+ * @brief Appends the record to the page buffer and writes the page to flash when it is full.
+ *        The oldest sector is dropped when the ring is full.
+ * @param timestamp System time of the reading in seconds, seconds since boot if the time is not synchronized yet.
+ * @param sensor_id Sensor index.
+ * @param centi_celsius Temperature in hundredths of Celsius.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - others: refer to error code esp_err.h
+ */
+esp_err_t aug_store_append(uint32_t timestamp, uint8_t sensor_id, int16_t centi_celsius);
+/**
+ * @brief Writes the partially filled page buffer to flash.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - others: refer to error code esp_err.h
+ */
+esp_err_t aug_store_flush(void);
+/**
+ * @brief Reads the oldest records written to flash without consuming them.
+ *        Empty and corrupted slots are skipped.
+ * @param out Buffer to store the records.
+ * @param n Number of elements in the buffer.
+ * @param slots Pointer to store the number of slots that should be passed to aug_store_consume.
+ * @param offset Pointer to store the offset the records are read from, it should be passed to aug_store_consume.
+ * @return size_t Number of valid records written to the buffer.
+ */
+size_t aug_store_peek(aug_store_record_t* out, size_t n, size_t* slots, size_t* offset);
+/**
+ * @brief Consumes slots read with aug_store_peek and erases fully drained sectors.
+ *        Should be called once the records are delivered.
+ * @param offset Offset returned by aug_store_peek.
+ * @param slots Number of slots to consume.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - ESP_ERR_INVALID_STATE: the oldest sector was dropped since the peek, nothing is consumed
+ *      - others: refer to error code esp_err.h
+ */
+esp_err_t aug_store_consume(size_t offset, size_t slots);
+/**
+ * @brief Returns true if there are no records written to flash.
+ * @return true If the store is empty or not initialized.
+ * @return false If there are records to drain.
+ */
+bool aug_store_is_empty(void);
+/**
+ * @brief Returns the current state of this module.
+ * @return true If the module is initialized.
+ * @return false If the module is not initialized.
+ */
+bool aug_store_is_init(void);
+
+#endif
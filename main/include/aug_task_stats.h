@@ -0,0 +1,52 @@
+/**
+ * @file aug_task_stats.h
+ * @brief Samples the FreeRTOS run-time stats of all tasks periodically and reports
+ *        per-task CPU load over the last period and the sliding window, stack high-water mark and state.
+ *        Compiled only with CONFIG_TASK_PROFILING.
+ */
+
+#if !defined(AUG_TASK_STATS_H)
+#define AUG_TASK_STATS_H
+
+#include <stddef.h>
+
+#include <esp_check.h>
+
+#if defined(CONFIG_TASK_PROFILING)
+#define DEFAULT_TASK_PROFILING_PERIOD CONFIG_TASK_PROFILING_PERIOD
+#define DEFAULT_TASK_PROFILING_WINDOW CONFIG_TASK_PROFILING_WINDOW
+#define DEFAULT_TASK_PROFILING_MAX_TASKS CONFIG_TASK_PROFILING_MAX_TASKS
+
+/**
+ * @brief Receives the rendered report piece by piece.
+ * @param data Rendered text, not null-terminated.
+ * @param len Length of the text.
+ * @param arg Argument passed to aug_task_stats_render.
+ * @return esp_err_t
+ *      - ESP_OK: continue rendering
+ *      - others: stop rendering and return the error
+ */
+typedef esp_err_t (*aug_task_stats_write_t)(const char* data, size_t len, void* arg);
+
+/**
+ * @brief Allocates the snapshots of the window and starts the sampling task.
+ * @return esp_err_t
+ *      - ESP_OK: succeed
+ *      - ESP_ERR_INVALID_STATE: the sampling is already started
+ *      - ESP_ERR_NO_MEM: the snapshots can't be allocated
+ *      - others: refer to error code esp_err.h
+ */
+esp_err_t aug_task_stats_start(void);
+/**
+ * @brief Renders the report of the last sample as JSON.
+ * @param write Callback receiving the text.
+ * @param arg Argument passed to the callback.
+ * @return esp_err_t
+ *      - ESP_OK: succeed
+ *      - ESP_ERR_INVALID_STATE: the sampling is not started
+ *      - others: returned by the callback
+ */
+esp_err_t aug_task_stats_render(aug_task_stats_write_t write, void* arg);
+#endif
+
+#endif
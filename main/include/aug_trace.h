@@ -0,0 +1,92 @@
+/**
+ * @file aug_trace.h
+ * @brief Records compact binary trace events into a ring instead of formatting log lines
+ *        on hot paths. Events are written without locks from any task and decoded
+ *        on the host from the dump, see tools/trace_decode.py.
+ */
+
+#if !defined(AUG_TRACE_H)
+#define AUG_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <esp_check.h>
+
+#define DEFAULT_TRACE_BUFFER_ENTRIES CONFIG_TRACE_BUFFER_ENTRIES
+#define AUG_TRACE_MAGIC 0x54475541 // "AUGT"
+#define AUG_TRACE_VERSION 1
+
+/**
+ * @brief Trace events, the numbers are part of the dump format and must match the decoder.
+ */
+typedef enum {
+    AUG_TRACE_EVENT_MQTT_ENQUEUE = 1,       // arg0: result, arg1: data length
+    AUG_TRACE_EVENT_MQTT_PUBLISHED = 2,     // arg1: message id acknowledged by the broker
+    AUG_TRACE_EVENT_PUBLISH_SKIPPED = 3,    // arg1: outbox size in bytes
+    AUG_TRACE_EVENT_PUBLISH_FAILED = 4,     // arg0: sensor index or sensors number for the batch, arg1: result
+    AUG_TRACE_EVENT_CONVERSION_FAILED = 5,  // arg0: bus index, arg1: result
+    AUG_TRACE_EVENT_READ_FAILED = 6,        // arg0: sensor index, arg1: result
+    AUG_TRACE_EVENT_QUERY_OPTION = 7,       // arg0: 1 if found, arg1: first 4 characters of the key
+    AUG_TRACE_EVENT_MODE_TO_STR = 8,        // arg0: 0 for the auth mode, 1 for the SAE mode, arg1: mode
+} aug_trace_event_t;
+
+/**
+ * @brief Entry of the ring. The sequence is written last, so a reader can detect
+ *        an entry that is being overwritten.
+ */
+typedef struct {
+    uint32_t sequence;      // Number of the entry since boot plus 1, 0 while the entry is written
+    uint32_t timestamp_us;  // Lower 32 bits of the time since boot
+    uint16_t event;
+    uint16_t arg0;
+    uint32_t arg1;
+} aug_trace_entry_t;
+
+/**
+ * @brief Header of the dump followed by the entries from the oldest to the newest.
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entry_size;
+    uint32_t entries_number;
+    uint32_t lost_entries;  // Entries overwritten before the dump
+} aug_trace_dump_header_t;
+
+/**
+ * @brief Receives the dump piece by piece.
+ * @param data Binary data.
+ * @param len Length of the data.
+ * @param arg Argument passed to aug_trace_dump.
+ * @return esp_err_t
+ *      - ESP_OK: continue dumping
+ *      - others: stop dumping and return the error
+ */
+typedef esp_err_t (*aug_trace_write_t)(const void* data, size_t len, void* arg);
+
+/**
+ * @brief Records the event. Can be called from any task without locking.
+ * @param event Event.
+ * @param arg0 Small argument of the event.
+ * @param arg1 Argument of the event.
+ */
+void aug_trace(aug_trace_event_t event, uint16_t arg0, uint32_t arg1);
+/**
+ * @brief Packs the first 4 characters of the string into a trace argument.
+ * @param str Null-terminated string.
+ * @return uint32_t Characters in little-endian order, padded with zeros.
+ */
+uint32_t aug_trace_pack_str(const char* str);
+/**
+ * @brief Writes the header and the entries of the ring from the oldest to the newest.
+ *        Entries overwritten while dumping are written with the sequence 0, so they never corrupt the dump.
+ * @param write Callback receiving the dump.
+ * @param arg Argument passed to the callback.
+ * @return esp_err_t
+ *      - ESP_OK: succeed
+ *      - others: returned by the callback
+ */
+esp_err_t aug_trace_dump(aug_trace_write_t write, void* arg);
+
+#endif
@@ -5,6 +5,9 @@
 #if !defined(AUG_UTILITY_H)
 #define AUG_UTILITY_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
 #include <esp_check.h>
 #include <esp_wifi_types.h>
 
@@ -28,6 +31,11 @@
 
 #define AUG_EXIT_NULL_CHECK(result) if (result == NULL) ESP_ERROR_CHECK(ESP_FAIL)
 
+/**
+ * @brief Size of the buffer that fits any raw temperature formatted by aug_raw_temperature_to_str.
+ */
+#define AUG_TEMPERATURE_STR_SIZE sizeof("-2048.00")
+
 /**
  * @brief Converts a string representation of Wi-Fi authentication mode to its corresponding enum.
  * @param buffer the buffer containing the string to be converted.
@@ -84,4 +92,57 @@ size_t aug_get_auth_mode_size();
  */
 size_t aug_get_sae_mode_size();
 
+/**
+ * @brief Formats the raw DS18B20 temperature in 1/16 Celsius as Celsius with two decimals
+ *        without floating point and libc formatting. The result matches "%.2f" of the same value.
+ * @param raw Temperature in 1/16 Celsius.
+ * @param buffer Buffer to store the null-terminated string.
+ * @param buffer_size Size of the buffer, AUG_TEMPERATURE_STR_SIZE is always enough.
+ * @return size_t Length of the string without null-terminator, 0 if the buffer is too small.
+ */
+size_t aug_raw_temperature_to_str(int16_t raw, char* buffer, size_t buffer_size);
+
+/**
+ * @brief Converts the raw DS18B20 temperature in 1/16 Celsius to hundredths of Celsius.
+ * @param raw Temperature in 1/16 Celsius.
+ * @return int16_t Temperature in hundredths of Celsius, saturated to the int16_t range.
+ */
+int16_t aug_raw_temperature_to_centi(int16_t raw);
+
+/**
+ * @brief Decides whether the reading is reported in the report-by-exception mode: it moved by the deadband 
+ *        or the heartbeat interval is over, but the minimum interval since the last reported reading is over too.
+ * @param change Absolute change since the last reported reading in 1/100 Celsius.
+ * @param elapsed_s Seconds since the last reported reading.
+ * @param deadband Deadband in 1/100 Celsius.
+ * @param min_interval Minimum interval between the reported readings in seconds.
+ * @param heartbeat_interval Maximum interval between the reported readings in seconds.
+ * @return true If the reading is due.
+ */
+bool aug_is_report_due(int change, int64_t elapsed_s, int deadband, int min_interval, int heartbeat_interval);
+
+/**
+ * @brief Returns the delay before the retry: the base delay doubled with every retry up to the maximum, 
+ *        the upper half of it is random so clients that failed at once don't retry in lockstep.
+ * @param retry Number of the retries made before.
+ * @param base_ms Delay before the first retry in milliseconds.
+ * @param max_ms Maximum delay in milliseconds.
+ * @param random Random value that picks the delay within the upper half, e.g. esp_random().
+ * @return uint32_t Delay in milliseconds.
+ */
+uint32_t aug_get_backoff_delay_ms(int retry, uint32_t base_ms, uint32_t max_ms, uint32_t random);
+
+/**
+ * @brief Converts the hex string to bytes.
+ * @param hex Hex string, case insensitive.
+ * @param hex_len Length of the string, should be twice the number of bytes.
+ * @param bytes Buffer to store the bytes.
+ * @param bytes_size Number of bytes to convert.
+ * @return esp_err_t 
+ *      - ESP_OK: succeed 
+ *      - ESP_ERR_INVALID_SIZE: the string length doesn't match the number of bytes
+ *      - ESP_ERR_INVALID_ARG: the string has non-hex characters
+ */
+esp_err_t aug_hex_to_bytes(const char* hex, size_t hex_len, uint8_t* bytes, size_t bytes_size);
+
 #endif
\ No newline at end of file
@@ -2,7 +2,7 @@
  * @file aug_wifi.h
  * @brief Retrieves default configurations and initializes common Wi-Fi resources.  
  * @warning Deallocation of resources is not working correctly.
- * @todo Make tests for multiple allocations-deallocations to check memleaks. 
+ * @see aug_heap_check.h for the memleak checks across the init and deinit cycles.
  * @todo Add support for deallocation. 
  */
 
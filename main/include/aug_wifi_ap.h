@@ -1,7 +1,7 @@
 /**
  * @file aug_wifi_ap.h
  * @brief Initializes Wi-Fi access point.  
- * @todo Make tests for multiple allocations-deallocations to check memleaks. 
+ * @see aug_heap_check.h for the memleak checks across the init and deinit cycles.
  */
 
 #if !defined(AUG_WIFI_AP_H)
@@ -1,7 +1,10 @@
 /**
  * @file aug_wifi_sta.h
- * @brief Connects to the Wi-Fi access point and send event if it's failed to connect.
- * @todo Make tests for multiple allocations-deallocations to check memleaks. 
+ * @brief Connects to the Wi-Fi access point in the background and sends events when it's connected
+ *        or failed to connect. Retries are delayed with the exponential backoff and jitter.
+ *        The last good AP is cached to skip the scan on the next connection.
+ *        The system time is synchronized with SNTP once the IP address is assigned.
+ * @see aug_heap_check.h for the memleak checks across the init and deinit cycles.
  */
 
 #if !defined(AUG_WIFI_STA_H)
@@ -11,10 +14,39 @@
 
 #include <esp_event.h>
 #include <esp_wifi_types.h>
+#include <esp_netif.h>
 #include <freertos/FreeRTOS.h>
 
 #include "aug_wifi.h"
 
+#define DEFAULT_STA_RETRY_BASE_DELAY CONFIG_STA_RETRY_BASE_DELAY
+#define DEFAULT_STA_RETRY_MAX_DELAY  CONFIG_STA_RETRY_MAX_DELAY
+#define DEFAULT_SNTP_SERVER CONFIG_SNTP_SERVER
+#if defined(CONFIG_STA_FAST_RECONNECT)
+#define DEFAULT_STA_FAST_RECONNECT true
+#else
+#define DEFAULT_STA_FAST_RECONNECT false
+#endif
+
+/**
+ * @brief The AP of the last successful connection.
+ */
+typedef struct {
+    uint8_t ssid[32];              // SSID the cache belongs to
+    uint8_t bssid[6];
+    uint8_t channel;
+    bool is_valid;
+} aug_wifi_sta_cache_t;
+
+/**
+ * @brief Data of AUG_WIFI_STA_EVENT_CONNECTED.
+ */
+typedef struct {
+    bool is_fast_path;        // Connected with the cached AP
+    bool is_cache_updated;    // The cache differs from the one the connection started with or was invalidated
+    uint32_t connect_time_ms; // Time from aug_wifi_sta_connect or the last disconnection to the IP
+} aug_wifi_sta_connected_event_t;
+
 /**
  * @brief Constructs a new esp event declare base object
  *        for publishing station mode events.
@@ -25,11 +57,21 @@ enum {
      * @brief Event publishes when the number of connection attempts exceeds the maximum allowed.
      */
     AUG_WIFI_STA_EVENT_FAILED_ATTEMPTS,
+    /**
+     * @brief Event publishes when an IP address is assigned, after the first connection and every reconnection.
+     *        The event data is aug_wifi_sta_connected_event_t.
+     */
+    AUG_WIFI_STA_EVENT_CONNECTED,
+    /**
+     * @brief Event publishes when the cached AP can't be connected and the cache is invalidated.
+     */
+    AUG_WIFI_STA_EVENT_CACHE_INVALIDATED,
 };
 /**
- * @brief Connects to the access point.
+ * @brief Starts connecting to the access point and returns without waiting for the connection.
  * Allocates resources that should be freed with aug_wifi_sta_disconnect.  
- * Awaits an IP address to be assigned by the DHCP server. 
+ * The result is published as AUG_WIFI_STA_EVENT_CONNECTED once the IP address is assigned
+ * or AUG_WIFI_STA_EVENT_FAILED_ATTEMPTS once the retries are exhausted.
  * @param _event_loop_handle Pointer to the event loop to publish events to.
  * @return esp_err_t 
  *      - ESP_OK: succeed 
@@ -44,6 +86,18 @@ esp_err_t aug_wifi_sta_connect(esp_event_loop_handle_t* _event_loop_handle);
  *      - others: refer to error code esp_err.h
  */
 esp_err_t aug_wifi_sta_disconnect(void);
+/**
+ * @brief Returns a pointer to the statically allocated cache of the last successful connection.
+ *        The cache is used by the next aug_wifi_sta_connect if it is valid and belongs to the configured SSID.
+ * @return aug_wifi_sta_cache_t* Pointer to statically allocated structure.
+ */
+aug_wifi_sta_cache_t* aug_wifi_sta_get_cache(void);
+/**
+ * @brief Returns whether the station is connected and has an IP address.
+ * @return true If the station is connected.
+ * @return false If the station is connecting, waiting for a retry or failed to connect.
+ */
+bool aug_wifi_sta_is_connected(void);
 /**
  * @brief Returns the current state of this module.
  * @return true If the module is initialized.
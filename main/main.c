@@ -23,60 +23,13 @@
 #include "aug_http_server.h"
 #include "aug_mqtt_client.h"
 #include "aug_ds18b20.h"
+#include "aug_publisher.h"
+#include "aug_store.h"
+#include "aug_task_stats.h"
+#include "aug_heap_check.h"
 
 static const char *TAG = "main";
 
-static uint8_t get_mac_hash() 
-{
-    uint8_t mac[6];
-    esp_err_t ret;
-
-    ret = esp_base_mac_addr_get(mac);
-    if (ret != ESP_OK) {
-        ESP_LOGI(TAG, "Failed to get MAC address");
-        return 0;
-    }
-
-    uint8_t hash = 0;
-    for (int i = 0; i < sizeof(mac); i++) {
-        hash = hash * hash + mac[i];
-    }
-    return hash;
-}
-
-static void publish_task(void* params)
-{
-    (void)params;
-    uint8_t mac_hash = get_mac_hash();
-    float temperature;
-    size_t sensors_number = aug_get_sensors_number();
-    char topic[128] = {};
-    char temperature_str[8] = {};
-    
-    while (1) {
-        for (size_t i = 0; i < sensors_number && aug_mqtt_is_connected(); ++i) {
-            temperature = aug_get_temperature(i);
-            memset(topic, 0, sizeof(topic));
-            snprintf(topic, sizeof(topic), 
-                "/devices/rtl-esp-wroom%i[%i]/controls/temperature/meta/type", mac_hash, i + 1);
-            aug_mqtt_publish_str(topic, "temperature");
-            
-            memset(topic, 0, sizeof(topic));
-            snprintf(topic, sizeof(topic), 
-                "/devices/rtl-esp-wroom%i[%i]/controls/temperature/meta/readonly", mac_hash, i + 1);
-            aug_mqtt_publish_str(topic, "1");
-            
-            memset(topic, 0, sizeof(topic));
-            snprintf(topic, sizeof(topic), 
-                "/devices/rtl-esp-wroom%i[%i]/controls/temperature", mac_hash, i + 1);
-            memset(temperature_str, 0, sizeof(temperature_str));
-            snprintf(temperature_str, sizeof(temperature_str), "%.2f", temperature);
-            aug_mqtt_publish_str(topic, temperature_str);
-        }
-        vTaskDelay(pdMS_TO_TICKS(DEFAULT_PUBLISH_RATE * 1000));
-    }
-}
-
 static void deinit_modules()
 {
     if (aug_http_is_init())
@@ -87,6 +40,18 @@ static void deinit_modules()
         ESP_ERROR_CHECK(aug_wifi_ap_stop());
 }
 
+/**
+ * @brief Checks that the heap returned to the baseline once the modules are torn down.
+ */
+static void check_heap_cycle(const char* name)
+{
+#if defined(CONFIG_HEAP_CHECK)
+    aug_heap_check_cycle(name);
+#else
+    (void)name;
+#endif
+}
+
 static void write_nvs_data()
 {
     ESP_ERROR_CHECK(aug_nvs_set_ap_config());
@@ -100,14 +65,37 @@ static void callback_init_sta(void* handler_arg, esp_event_base_t base, int32_t
     (void)id;
     (void)event_data;
     esp_event_loop_handle_t* event_loop_handle = (esp_event_loop_handle_t*)handler_arg;
-    if (aug_mqtt_is_connected())
+    if (aug_mqtt_is_started())
         ESP_ERROR_CHECK(aug_mqtt_stop());
     deinit_modules();
+    check_heap_cycle("sta");
 
     if (aug_wifi_sta_connect(event_loop_handle) != ESP_OK)
         return;
     aug_http_start(event_loop_handle);
-    ESP_ERROR_CHECK(aug_mqtt_start());
+}
+
+static void callback_sta_connected(void* handler_arg, esp_event_base_t base, int32_t id, void* event_data)
+{
+    (void)handler_arg;
+    (void)base;
+    (void)id;
+    const aug_wifi_sta_connected_event_t* connected = (const aug_wifi_sta_connected_event_t*)event_data;
+    if (connected->is_cache_updated && aug_nvs_set_sta_cache() != ESP_OK)
+        ESP_LOGI(TAG, "Failed to store the station cache, the next connection will scan");
+    // The client reconnects by itself, so it is started only after the first connection.
+    if (aug_mqtt_is_init() && !aug_mqtt_is_started())
+        ESP_ERROR_CHECK(aug_mqtt_start());
+}
+
+static void callback_sta_cache_invalidated(void* handler_arg, esp_event_base_t base, int32_t id, void* event_data)
+{
+    (void)handler_arg;
+    (void)base;
+    (void)id;
+    (void)event_data;
+    if (aug_nvs_set_sta_cache() != ESP_OK)
+        ESP_LOGI(TAG, "Failed to store the invalidated station cache");
 }
 
 static void callback_init_ap(void* handler_arg, esp_event_base_t base, int32_t id, void* event_data)
@@ -116,9 +104,10 @@ static void callback_init_ap(void* handler_arg, esp_event_base_t base, int32_t i
     (void)id;
     (void)event_data;
     esp_event_loop_handle_t* event_loop_handle = (esp_event_loop_handle_t*)handler_arg;
-    if (aug_mqtt_is_connected())
+    if (aug_mqtt_is_started())
         ESP_ERROR_CHECK(aug_mqtt_stop());
     deinit_modules();
+    check_heap_cycle("ap");
 
     ESP_ERROR_CHECK(aug_wifi_ap_start(event_loop_handle));
     aug_http_start(event_loop_handle);
@@ -130,6 +119,9 @@ static void callback_init_mqtt(void* handler_arg, esp_event_base_t base, int32_t
     (void)base;
     (void)id;
     (void)event_data;
+    if (!aug_mqtt_is_init())
+        return;
+    // The client is restarted only if it is started, otherwise the station connection starts it.
     ESP_ERROR_CHECK(aug_mqtt_set_uri());
 }
 
@@ -139,7 +131,7 @@ static void callback_esp_restart(void* handler_arg, esp_event_base_t base, int32
     (void)base;
     (void)id;
     (void)event_data;
-    if (aug_mqtt_is_connected())
+    if (aug_mqtt_is_started())
         ESP_ERROR_CHECK(aug_mqtt_stop());
     deinit_modules();
     write_nvs_data();
@@ -167,6 +159,10 @@ void register_events(esp_event_loop_handle_t* event_loop_handle)
 {
     ESP_ERROR_CHECK(esp_event_handler_instance_register_with(*event_loop_handle, AUG_WIFI_STA_EVENTS, 
         AUG_WIFI_STA_EVENT_FAILED_ATTEMPTS, callback_init_ap, event_loop_handle, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register_with(*event_loop_handle, AUG_WIFI_STA_EVENTS, 
+        AUG_WIFI_STA_EVENT_CONNECTED, callback_sta_connected, event_loop_handle, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register_with(*event_loop_handle, AUG_WIFI_STA_EVENTS, 
+        AUG_WIFI_STA_EVENT_CACHE_INVALIDATED, callback_sta_cache_invalidated, event_loop_handle, NULL));
     ESP_ERROR_CHECK(esp_event_handler_instance_register_with(*event_loop_handle, AUG_WIFI_AP_EVENTS, 
         AUG_WIFI_AP_EVENT_IDLE, callback_init_sta, event_loop_handle, NULL));
     ESP_ERROR_CHECK(esp_event_handler_instance_register_with(*event_loop_handle, AUG_HTTP_SERVER_EVENTS, 
@@ -191,6 +187,8 @@ static void main_init(esp_event_loop_handle_t* event_loop_handle)
         *sta_config = aug_wifi_get_default_sta_config();
 #endif
     }
+    if (aug_nvs_get_sta_cache() != ESP_OK)
+        ESP_LOGI(TAG, "No station cache found in the NVS, the first connection will scan");
     esp_err_t is_ap_config_found = aug_nvs_get_ap_config();
     if (is_ap_config_found != ESP_OK) {
         ESP_LOGI(TAG, "No access point mode configuration found in the NVS");
@@ -198,17 +196,6 @@ static void main_init(esp_event_loop_handle_t* event_loop_handle)
         memset(ap_config, 0, sizeof(*ap_config));
         *ap_config = aug_wifi_get_default_ap_config();
     }
-    if (is_sta_config_found == ESP_OK) {
-        aug_wifi_sta_connect(event_loop_handle);
-    }
-    else {
-#if defined(CONFIG_WIFI_INFO)
-    aug_wifi_sta_connect(event_loop_handle);
-#else
-    ESP_ERROR_CHECK(aug_wifi_ap_start(event_loop_handle));
-#endif
-    }
-
     if (aug_nvs_get_mqtt_config() != ESP_OK) {
         ESP_LOGI(TAG, "No MQTT client configuration found in the NVS");
         aug_mqtt_set_default_uri();
@@ -216,14 +203,35 @@ static void main_init(esp_event_loop_handle_t* event_loop_handle)
     aug_mqtt_uri_t mqtt_uri = aug_mqtt_get_uri();
     esp_mqtt_client_config_t* mqtt_config = aug_mqtt_get_config();
     mqtt_config->broker.address.uri = mqtt_uri.uri_str;
+    // The client is started by the connected event, so it exists before the station connects.
+    ESP_ERROR_CHECK(aug_mqtt_init());
 
-    register_events(event_loop_handle);
+    // The publisher registers the retained meta topics and the HTTP server is started 
+    // before any event can be posted, so the first connection and the mode switch find them ready.
     ESP_ERROR_CHECK(aug_ds18b20_init());
+    ESP_ERROR_CHECK(aug_ds18b20_start_sampler(DEFAULT_SAMPLE_RATE * 1000));
+    if (aug_store_init() != ESP_OK)
+        ESP_LOGI(TAG, "Store is not available, readings taken while disconnected will be lost");
+    ESP_ERROR_CHECK(aug_publisher_start());
+#if defined(CONFIG_TASK_PROFILING)
+    ESP_ERROR_CHECK(aug_task_stats_start());
+#endif
     aug_http_start(event_loop_handle);
-    ESP_ERROR_CHECK(aug_mqtt_init());
-    if (aug_wifi_sta_is_init())
-        ESP_ERROR_CHECK(aug_mqtt_start());
-    xTaskCreate(publish_task, "publish_task", 1024 * 3, NULL, 5, NULL);
+    register_events(event_loop_handle);
+
+    if (is_sta_config_found == ESP_OK) {
+        aug_wifi_sta_connect(event_loop_handle);
+    }
+    else {
+#if defined(CONFIG_WIFI_INFO)
+    aug_wifi_sta_connect(event_loop_handle);
+#else
+    ESP_ERROR_CHECK(aug_wifi_ap_start(event_loop_handle));
+#endif
+    }
+#if defined(CONFIG_HEAP_CHECK)
+    ESP_ERROR_CHECK(aug_heap_check_start_soak(event_loop_handle));
+#endif
 }
 
 static void main_loop(void)
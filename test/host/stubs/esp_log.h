@@ -0,0 +1,10 @@
+/* The log is compiled out on the host, the arguments are still type checked. */
+#pragma once
+
+#include <stdio.h>
+
+#define ESP_LOG_HOST(tag, format, ...) do { if (0) printf("%s: " format, tag, ##__VA_ARGS__); } while (0)
+#define ESP_LOGE(tag, format, ...) ESP_LOG_HOST(tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_HOST(tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_HOST(tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_HOST(tag, format, ##__VA_ARGS__)
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <stdint.h>
+
+uint8_t esp_rom_crc8_le(uint8_t crc, const uint8_t* buf, uint32_t len);
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Returns the fake time set with fake_timer_set_us.
+ */
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,144 @@
+#include "fake_idf.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <esp_err.h>
+#include <esp_timer.h>
+#include <esp_rom_crc.h>
+#include <esp_partition.h>
+#include <spi_flash_mmap.h>
+#include <freertos/semphr.h>
+
+static int64_t time_us = 0;
+static esp_partition_t partition = {};
+static uint8_t* partition_data = NULL;
+static size_t partition_erases = 0;
+
+typedef struct {
+    int taken;
+} fake_mutex_t;
+
+const char* esp_err_to_name(esp_err_t code)
+{
+    return code == ESP_OK ? "ESP_OK" : "ERROR";
+}
+
+void fake_timer_set_us(int64_t now_us)
+{
+    time_us = now_us;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return time_us;
+}
+
+uint8_t esp_rom_crc8_le(uint8_t crc, const uint8_t* buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int bit = 0; bit < 8; ++bit)
+            crc = crc & 1 ? (crc >> 1) ^ 0x8C : crc >> 1;
+    }
+    return ~crc;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return calloc(1, sizeof(fake_mutex_t));
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    free(semaphore);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    (void)ticks;
+    fake_mutex_t* mutex = semaphore;
+    // The tests are single-threaded, so taking the taken mutex would deadlock on the target.
+    assert(!mutex->taken && "the mutex is already taken");
+    mutex->taken = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    fake_mutex_t* mutex = semaphore;
+    assert(mutex->taken && "the mutex is not taken");
+    mutex->taken = 0;
+    return pdTRUE;
+}
+
+void fake_partition_create(size_t size)
+{
+    fake_partition_delete();
+    partition_data = malloc(size);
+    assert(partition_data);
+    memset(partition_data, 0xFF, size);
+    partition = (esp_partition_t) {
+        .type = ESP_PARTITION_TYPE_DATA,
+        .subtype = 0x40,
+        .size = size,
+        .label = "readings",
+    };
+    partition_erases = 0;
+}
+
+void fake_partition_delete(void)
+{
+    free(partition_data);
+    partition_data = NULL;
+}
+
+uint8_t* fake_partition_data(void)
+{
+    return partition_data;
+}
+
+size_t fake_partition_get_erases(void)
+{
+    return partition_erases;
+}
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, 
+    esp_partition_subtype_t subtype, const char* label)
+{
+    if (!partition_data || type != partition.type || subtype != partition.subtype 
+            || strcmp(label, partition.label) != 0)
+        return NULL;
+    return &partition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* part, size_t src_offset, void* dst, size_t size)
+{
+    if (part != &partition || src_offset + size > partition.size)
+        return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, &partition_data[src_offset], size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* part, size_t dst_offset, const void* src, size_t size)
+{
+    if (part != &partition || dst_offset + size > partition.size)
+        return ESP_ERR_INVALID_SIZE;
+    // NOR flash only clears bits, so writing over data that is not erased corrupts it like on the chip.
+    const uint8_t* bytes = src;
+    for (size_t i = 0; i < size; ++i)
+        partition_data[dst_offset + i] &= bytes[i];
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* part, size_t offset, size_t size)
+{
+    if (part != &partition || offset + size > partition.size 
+            || offset % SPI_FLASH_SEC_SIZE != 0 || size % SPI_FLASH_SEC_SIZE != 0)
+        return ESP_ERR_INVALID_ARG;
+    memset(&partition_data[offset], 0xFF, size);
+    partition_erases += size / SPI_FLASH_SEC_SIZE;
+    return ESP_OK;
+}
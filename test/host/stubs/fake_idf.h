@@ -0,0 +1,33 @@
+/**
+ * @file fake_idf.h
+ * @brief Controls of the fake ESP-IDF services the modules are built against on the host.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Sets the time returned by esp_timer_get_time.
+ * @param time_us Time since boot in microseconds.
+ */
+void fake_timer_set_us(int64_t time_us);
+/**
+ * @brief Creates the erased partition of the store, found by esp_partition_find_first.
+ * @param size Size of the partition in bytes.
+ */
+void fake_partition_create(size_t size);
+/**
+ * @brief Frees the partition created with fake_partition_create, so it isn't found anymore.
+ */
+void fake_partition_delete(void);
+/**
+ * @brief Returns the content of the partition to corrupt or inspect it directly.
+ * @return uint8_t* Pointer to the partition content.
+ */
+uint8_t* fake_partition_data(void);
+/**
+ * @brief Returns the number of sector erases since the partition was created.
+ * @return size_t Number of erased sectors.
+ */
+size_t fake_partition_get_erases(void);
@@ -0,0 +1,8 @@
+/* Configuration of the host build, values match the default sdkconfig. */
+#pragma once
+
+#define CONFIG_TRACE_BUFFER_ENTRIES 256
+#define CONFIG_HISTORY_MAX_SAMPLES 360
+#define CONFIG_SAMPLE_RATE 10
+#define CONFIG_STORE_DRAIN_BATCH 64
+#define CONFIG_STORE_DRAIN_INTERVAL 100
@@ -0,0 +1,155 @@
+#include <stdlib.h>
+
+#include <unity.h>
+
+#include "aug_history.h"
+
+// One sample every 10 s keeps 6 samples in the 1 minute window, 90 in 15 minutes and 360 in the hour.
+#define PERIOD_MS (10 * 1000)
+#define SENSORS_NUMBER 3
+
+static const uint32_t window_lens[AUG_HISTORY_WINDOW_NUM] = { 6, 90, 360 };
+static aug_history_t* history = NULL;
+
+void setUp(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, aug_history_create(SENSORS_NUMBER, PERIOD_MS, &history));
+}
+
+void tearDown(void)
+{
+    aug_history_delete(history);
+    history = NULL;
+}
+
+static void test_create_invalid_period(void)
+{
+    aug_history_t* other = NULL;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, aug_history_create(1, 0, &other));
+}
+
+static void test_get_stats_invalid_args(void)
+{
+    aug_history_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, aug_history_get_stats(history, SENSORS_NUMBER, AUG_HISTORY_WINDOW_1M, &stats));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, aug_history_get_stats(history, 0, AUG_HISTORY_WINDOW_NUM, &stats));
+}
+
+static void test_empty_window(void)
+{
+    aug_history_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, aug_history_get_stats(history, 0, AUG_HISTORY_WINDOW_1H, &stats));
+    TEST_ASSERT_EQUAL_UINT32(0, stats.count);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.mean);
+}
+
+static void test_window_rolls_over(void)
+{
+    for (int celsius = 1; celsius <= 10; ++celsius)
+        aug_history_push(history, 1, celsius * 16, true);
+
+    aug_history_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, aug_history_get_stats(history, 1, AUG_HISTORY_WINDOW_1M, &stats));
+    TEST_ASSERT_EQUAL_UINT32(6, stats.count);
+    TEST_ASSERT_EQUAL_FLOAT(5.0f, stats.min);
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, stats.max);
+    TEST_ASSERT_EQUAL_FLOAT(7.5f, stats.mean);
+
+    TEST_ASSERT_EQUAL(ESP_OK, aug_history_get_stats(history, 1, AUG_HISTORY_WINDOW_15M, &stats));
+    TEST_ASSERT_EQUAL_UINT32(10, stats.count);
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, stats.min);
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, stats.max);
+    TEST_ASSERT_EQUAL_FLOAT(5.5f, stats.mean);
+
+    // Other sensors are not affected.
+    TEST_ASSERT_EQUAL(ESP_OK, aug_history_get_stats(history, 0, AUG_HISTORY_WINDOW_15M, &stats));
+    TEST_ASSERT_EQUAL_UINT32(0, stats.count);
+}
+
+static void test_variance(void)
+{
+    aug_history_push(history, 0, 0, true);
+    aug_history_push(history, 0, 2 * 16, true);
+
+    aug_history_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, aug_history_get_stats(history, 0, AUG_HISTORY_WINDOW_1M, &stats));
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, stats.mean);
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, stats.variance);
+}
+
+static void test_invalid_samples_take_place(void)
+{
+    for (int i = 0; i < 6; ++i)
+        aug_history_push(history, 2, 100, true);
+    for (int i = 0; i < 6; ++i)
+        aug_history_push(history, 2, 0, false);
+
+    aug_history_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, aug_history_get_stats(history, 2, AUG_HISTORY_WINDOW_1M, &stats));
+    TEST_ASSERT_EQUAL_UINT32(0, stats.count);
+    TEST_ASSERT_EQUAL(ESP_OK, aug_history_get_stats(history, 2, AUG_HISTORY_WINDOW_15M, &stats));
+    TEST_ASSERT_EQUAL_UINT32(6, stats.count);
+    TEST_ASSERT_EQUAL_FLOAT(100 / 16.0f, stats.min);
+}
+
+/**
+ * @brief Compares the rolling aggregates with the ones computed over the window from scratch,
+ *        long enough for the sample numbers kept in the queues to wrap around 16 bits.
+ */
+static void test_matches_brute_force(void)
+{
+    const size_t samples_number = 70000;
+    int16_t* values = malloc(samples_number * sizeof(*values));
+    bool* valid = malloc(samples_number * sizeof(*valid));
+    TEST_ASSERT_NOT_NULL(values);
+    TEST_ASSERT_NOT_NULL(valid);
+    uint32_t seed = 12345;
+
+    for (size_t sample = 0; sample < samples_number; ++sample) {
+        seed = seed * 1103515245 + 12345;
+        values[sample] = (int16_t)((seed >> 16) % 2001) - 1000;
+        valid[sample] = (seed >> 8) % 10 != 0;
+        aug_history_push(history, 0, values[sample], valid[sample]);
+        if (sample % 97 != 0)
+            continue;
+
+        for (int window = 0; window < AUG_HISTORY_WINDOW_NUM; ++window) {
+            size_t first = sample + 1 > window_lens[window] ? sample + 1 - window_lens[window] : 0;
+            int16_t min = INT16_MAX;
+            int16_t max = INT16_MIN;
+            int64_t sum = 0;
+            uint32_t count = 0;
+            for (size_t i = first; i <= sample; ++i) {
+                if (!valid[i])
+                    continue;
+                min = values[i] < min ? values[i] : min;
+                max = values[i] > max ? values[i] : max;
+                sum += values[i];
+                ++count;
+            }
+            aug_history_stats_t stats;
+            TEST_ASSERT_EQUAL(ESP_OK, aug_history_get_stats(history, 0, window, &stats));
+            TEST_ASSERT_EQUAL_UINT32(count, stats.count);
+            if (count == 0)
+                continue;
+            TEST_ASSERT_EQUAL_FLOAT(min / 16.0f, stats.min);
+            TEST_ASSERT_EQUAL_FLOAT(max / 16.0f, stats.max);
+            TEST_ASSERT_FLOAT_WITHIN(0.001f, (float)sum / count / 16.0f, stats.mean);
+        }
+    }
+    free(values);
+    free(valid);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_create_invalid_period);
+    RUN_TEST(test_get_stats_invalid_args);
+    RUN_TEST(test_empty_window);
+    RUN_TEST(test_window_rolls_over);
+    RUN_TEST(test_variance);
+    RUN_TEST(test_invalid_samples_take_place);
+    RUN_TEST(test_matches_brute_force);
+    return UNITY_END();
+}
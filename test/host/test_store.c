@@ -0,0 +1,206 @@
+#include <string.h>
+
+#include <unity.h>
+
+#include "aug_store.h"
+#include "fake_idf.h"
+
+#define SECTOR_SIZE 4096
+#define SECTORS_NUMBER 4
+#define RECORDS_PER_PAGE (256 / sizeof(aug_store_record_t))
+#define RECORDS_PER_SECTOR (SECTOR_SIZE / sizeof(aug_store_record_t))
+
+void setUp(void)
+{
+    fake_partition_create(SECTORS_NUMBER * SECTOR_SIZE);
+    TEST_ASSERT_EQUAL(ESP_OK, aug_store_init());
+}
+
+void tearDown(void)
+{
+    fake_partition_delete();
+}
+
+/**
+ * @brief Appends the records numbered by the timestamp, the temperature is derived from it.
+ */
+static void append_records(uint32_t first, size_t count)
+{
+    for (uint32_t timestamp = first; timestamp < first + count; ++timestamp)
+        TEST_ASSERT_EQUAL(ESP_OK, aug_store_append(timestamp, timestamp % 7, (int16_t)timestamp));
+}
+
+static void test_init_without_partition(void)
+{
+    fake_partition_delete();
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, aug_store_init());
+    TEST_ASSERT_FALSE(aug_store_is_init());
+    TEST_ASSERT_TRUE(aug_store_is_empty());
+}
+
+static void test_init_small_partition(void)
+{
+    fake_partition_create(SECTOR_SIZE + SECTOR_SIZE / 2);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, aug_store_init());
+}
+
+static void test_records_are_written_by_pages(void)
+{
+    aug_store_record_t records[8];
+    size_t slots = 0;
+    size_t offset = 0;
+    append_records(0, 5);
+    TEST_ASSERT_TRUE(aug_store_is_empty());
+    TEST_ASSERT_EQUAL(0, aug_store_peek(records, 8, &slots, &offset));
+    TEST_ASSERT_EQUAL(0, slots);
+
+    TEST_ASSERT_EQUAL(ESP_OK, aug_store_flush());
+    TEST_ASSERT_FALSE(aug_store_is_empty());
+    TEST_ASSERT_EQUAL(5, aug_store_peek(records, 8, &slots, &offset));
+    TEST_ASSERT_EQUAL(8, slots);
+    for (uint32_t i = 0; i < 5; ++i) {
+        TEST_ASSERT_EQUAL_UINT32(i, records[i].timestamp);
+        TEST_ASSERT_EQUAL_UINT8(i % 7, records[i].sensor_id);
+        TEST_ASSERT_EQUAL_INT16(i, records[i].centi_celsius);
+    }
+}
+
+static void test_consume_drains_store(void)
+{
+    aug_store_record_t records[RECORDS_PER_PAGE * 2];
+    size_t slots = 0;
+    size_t offset = 0;
+    append_records(0, RECORDS_PER_PAGE + 8);
+    TEST_ASSERT_EQUAL(ESP_OK, aug_store_flush());
+
+    TEST_ASSERT_EQUAL(RECORDS_PER_PAGE, aug_store_peek(records, RECORDS_PER_PAGE, &slots, &offset));
+    TEST_ASSERT_EQUAL(ESP_OK, aug_store_consume(offset, slots));
+    // The padding of the flushed page is skipped, but its slots are consumed.
+    TEST_ASSERT_EQUAL(8, aug_store_peek(records, RECORDS_PER_PAGE * 2, &slots, &offset));
+    TEST_ASSERT_EQUAL(RECORDS_PER_PAGE, slots);
+    TEST_ASSERT_EQUAL_UINT32(RECORDS_PER_PAGE, records[0].timestamp);
+    TEST_ASSERT_EQUAL(ESP_OK, aug_store_consume(offset, slots));
+    TEST_ASSERT_TRUE(aug_store_is_empty());
+}
+
+static void test_corrupted_record_is_skipped(void)
+{
+    aug_store_record_t records[RECORDS_PER_PAGE];
+    size_t slots = 0;
+    size_t offset = 0;
+    append_records(0, RECORDS_PER_PAGE);
+    fake_partition_data()[3 * sizeof(aug_store_record_t)] ^= 0x01;
+
+    TEST_ASSERT_EQUAL(RECORDS_PER_PAGE - 1, aug_store_peek(records, RECORDS_PER_PAGE, &slots, &offset));
+    TEST_ASSERT_EQUAL(RECORDS_PER_PAGE, slots);
+    TEST_ASSERT_EQUAL_UINT32(2, records[2].timestamp);
+    TEST_ASSERT_EQUAL_UINT32(4, records[3].timestamp);
+}
+
+static void test_drained_sector_is_erased(void)
+{
+    aug_store_record_t records[RECORDS_PER_PAGE];
+    size_t slots = 0;
+    size_t offset = 0;
+    append_records(0, RECORDS_PER_SECTOR + RECORDS_PER_PAGE);
+    const size_t erases = fake_partition_get_erases();
+
+    for (size_t consumed = 0; consumed < RECORDS_PER_SECTOR; consumed += slots) {
+        aug_store_peek(records, RECORDS_PER_PAGE, &slots, &offset);
+        TEST_ASSERT_EQUAL(ESP_OK, aug_store_consume(offset, slots));
+    }
+    TEST_ASSERT_EQUAL(erases + 1, fake_partition_get_erases());
+    TEST_ASSERT_EQUAL_HEX8(0xFF, fake_partition_data()[0]);
+    TEST_ASSERT_EQUAL(RECORDS_PER_PAGE, aug_store_peek(records, RECORDS_PER_PAGE, &slots, &offset));
+    TEST_ASSERT_EQUAL_UINT32(RECORDS_PER_SECTOR, records[0].timestamp);
+}
+
+static void test_recovery_after_reboot(void)
+{
+    aug_store_record_t records[RECORDS_PER_PAGE];
+    size_t slots = 0;
+    size_t offset = 0;
+    append_records(0, RECORDS_PER_SECTOR + 40);
+    TEST_ASSERT_EQUAL(ESP_OK, aug_store_flush());
+    aug_store_peek(records, RECORDS_PER_PAGE, &slots, &offset);
+    TEST_ASSERT_EQUAL(ESP_OK, aug_store_consume(offset, slots));
+
+    // The partially drained sector is drained again, so the records are delivered at least once.
+    TEST_ASSERT_EQUAL(ESP_OK, aug_store_init());
+    TEST_ASSERT_EQUAL(RECORDS_PER_PAGE, aug_store_peek(records, RECORDS_PER_PAGE, &slots, &offset));
+    TEST_ASSERT_EQUAL_UINT32(0, records[0].timestamp);
+
+    // New records continue after the recovered head.
+    append_records(10000, RECORDS_PER_PAGE);
+    size_t total = 0;
+    uint32_t last_timestamp = 0;
+    while (!aug_store_is_empty()) {
+        size_t count = aug_store_peek(records, RECORDS_PER_PAGE, &slots, &offset);
+        total += count;
+        if (count > 0)
+            last_timestamp = records[count - 1].timestamp;
+        TEST_ASSERT_EQUAL(ESP_OK, aug_store_consume(offset, slots));
+    }
+    TEST_ASSERT_EQUAL(RECORDS_PER_SECTOR + 40 + RECORDS_PER_PAGE, total);
+    TEST_ASSERT_EQUAL_UINT32(10000 + RECORDS_PER_PAGE - 1, last_timestamp);
+}
+
+static void test_full_ring_drops_oldest_sector(void)
+{
+    aug_store_record_t records[1];
+    size_t slots = 0;
+    size_t offset = 0;
+    append_records(0, SECTORS_NUMBER * RECORDS_PER_SECTOR);
+
+    TEST_ASSERT_EQUAL(1, aug_store_peek(records, 1, &slots, &offset));
+    TEST_ASSERT_EQUAL_UINT32(RECORDS_PER_SECTOR, records[0].timestamp);
+
+    // The wrapped ring is recovered with the same tail.
+    TEST_ASSERT_EQUAL(ESP_OK, aug_store_init());
+    TEST_ASSERT_EQUAL(1, aug_store_peek(records, 1, &slots, &offset));
+    TEST_ASSERT_EQUAL_UINT32(RECORDS_PER_SECTOR, records[0].timestamp);
+}
+
+static void test_consume_after_dropped_sector(void)
+{
+    aug_store_record_t records[RECORDS_PER_PAGE];
+    size_t slots = 0;
+    size_t offset = 0;
+    append_records(0, (SECTORS_NUMBER - 1) * RECORDS_PER_SECTOR);
+    TEST_ASSERT_EQUAL(RECORDS_PER_PAGE, aug_store_peek(records, RECORDS_PER_PAGE, &slots, &offset));
+
+    // The ring fills while the batch is in flight, so the oldest sector with the batch is dropped.
+    append_records(100000, RECORDS_PER_SECTOR);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, aug_store_consume(offset, slots));
+    TEST_ASSERT_EQUAL(1, aug_store_peek(records, 1, &slots, &offset));
+    TEST_ASSERT_EQUAL_UINT32(RECORDS_PER_SECTOR, records[0].timestamp);
+}
+
+static void test_lost_order_drops_first_sector(void)
+{
+    memset(fake_partition_data(), 0, SECTORS_NUMBER * SECTOR_SIZE);
+    TEST_ASSERT_EQUAL(ESP_OK, aug_store_init());
+    TEST_ASSERT_EQUAL_HEX8(0xFF, fake_partition_data()[0]);
+    append_records(0, RECORDS_PER_PAGE);
+
+    aug_store_record_t records[1];
+    size_t slots = 0;
+    size_t offset = 0;
+    TEST_ASSERT_EQUAL(0, aug_store_peek(records, 1, &slots, &offset));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_init_without_partition);
+    RUN_TEST(test_init_small_partition);
+    RUN_TEST(test_records_are_written_by_pages);
+    RUN_TEST(test_consume_drains_store);
+    RUN_TEST(test_corrupted_record_is_skipped);
+    RUN_TEST(test_drained_sector_is_erased);
+    RUN_TEST(test_recovery_after_reboot);
+    RUN_TEST(test_full_ring_drops_oldest_sector);
+    RUN_TEST(test_consume_after_dropped_sector);
+    RUN_TEST(test_lost_order_drops_first_sector);
+    return UNITY_END();
+}
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include "aug_utility.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_temperature_str_matches_printf(void)
+{
+    char expected[16];
+    char actual[AUG_TEMPERATURE_STR_SIZE];
+    for (int32_t raw = INT16_MIN; raw <= INT16_MAX; ++raw) {
+        int expected_len = snprintf(expected, sizeof(expected), "%.2f", raw / 16.0);
+        size_t len = aug_raw_temperature_to_str(raw, actual, sizeof(actual));
+        TEST_ASSERT_EQUAL_STRING(expected, actual);
+        TEST_ASSERT_EQUAL(expected_len, len);
+    }
+}
+
+static void test_temperature_str_small_buffer(void)
+{
+    char buffer[6] = "xxxxx";
+    TEST_ASSERT_EQUAL(0, aug_raw_temperature_to_str(-16 * 100, buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL(5, aug_raw_temperature_to_str(16 * 10, buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_STRING("10.00", buffer);
+}
+
+static void test_temperature_centi(void)
+{
+    TEST_ASSERT_EQUAL_INT16(0, aug_raw_temperature_to_centi(0));
+    TEST_ASSERT_EQUAL_INT16(100, aug_raw_temperature_to_centi(16));
+    TEST_ASSERT_EQUAL_INT16(-100, aug_raw_temperature_to_centi(-16));
+    // 6.25 and 12.5 and 37.5 hundredths, ties are rounded to even like printf does.
+    TEST_ASSERT_EQUAL_INT16(6, aug_raw_temperature_to_centi(1));
+    TEST_ASSERT_EQUAL_INT16(12, aug_raw_temperature_to_centi(2));
+    TEST_ASSERT_EQUAL_INT16(38, aug_raw_temperature_to_centi(6));
+    TEST_ASSERT_EQUAL_INT16(12500, aug_raw_temperature_to_centi(125 * 16));
+    TEST_ASSERT_EQUAL_INT16(INT16_MAX, aug_raw_temperature_to_centi(INT16_MAX));
+    TEST_ASSERT_EQUAL_INT16(INT16_MIN, aug_raw_temperature_to_centi(INT16_MIN));
+}
+
+static void test_hex_to_bytes(void)
+{
+    uint8_t bytes[4] = {};
+    const uint8_t expected[4] = { 0x01, 0xAB, 0xcd, 0xEF };
+    TEST_ASSERT_EQUAL(ESP_OK, aug_hex_to_bytes("01abCDef", 8, bytes, sizeof(bytes)));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, bytes, sizeof(bytes));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, aug_hex_to_bytes("01abCDe", 7, bytes, sizeof(bytes)));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, aug_hex_to_bytes("01abCDeg", 8, bytes, sizeof(bytes)));
+}
+
+static void test_auth_mode_round_trip(void)
+{
+    char buffer[32];
+    wifi_auth_mode_t auth_mode = WIFI_AUTH_OPEN;
+    TEST_ASSERT_EQUAL(ESP_OK, aug_auth_mode_to_str(WIFI_AUTH_WPA2_WPA3_PSK, buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_STRING("wpa2_wpa3_psk", buffer);
+    TEST_ASSERT_EQUAL(ESP_OK, aug_str_to_auth_mode(buffer, strlen(buffer), &auth_mode));
+    TEST_ASSERT_EQUAL(WIFI_AUTH_WPA2_WPA3_PSK, auth_mode);
+    TEST_ASSERT_EQUAL(ESP_FAIL, aug_str_to_auth_mode("wpa", 3, &auth_mode));
+    TEST_ASSERT_EQUAL(ESP_FAIL, aug_auth_mode_to_str(WIFI_AUTH_OPEN, buffer, 4));
+}
+
+static void test_report_deadband(void)
+{
+    // Deadband 0.5 Celsius, minimum interval 10 s, heartbeat 300 s.
+    TEST_ASSERT_FALSE(aug_is_report_due(49, 20, 50, 10, 300));
+    TEST_ASSERT_TRUE(aug_is_report_due(50, 20, 50, 10, 300));
+    TEST_ASSERT_TRUE(aug_is_report_due(1000, 10, 50, 10, 300));
+}
+
+static void test_report_min_interval(void)
+{
+    TEST_ASSERT_FALSE(aug_is_report_due(1000, 9, 50, 10, 300));
+    TEST_ASSERT_FALSE(aug_is_report_due(0, 0, 0, 10, 0));
+}
+
+static void test_report_heartbeat(void)
+{
+    TEST_ASSERT_FALSE(aug_is_report_due(0, 299, 50, 10, 300));
+    TEST_ASSERT_TRUE(aug_is_report_due(0, 300, 50, 10, 300));
+    // The minimum interval wins over the heartbeat that is shorter.
+    TEST_ASSERT_FALSE(aug_is_report_due(0, 5, 50, 10, 1));
+}
+
+static void test_backoff_doubles_up_to_max(void)
+{
+    // The random value 0 picks the lower bound, the half of the delay.
+    TEST_ASSERT_EQUAL_UINT32(250, aug_get_backoff_delay_ms(0, 500, 30000, 0));
+    TEST_ASSERT_EQUAL_UINT32(500, aug_get_backoff_delay_ms(1, 500, 30000, 0));
+    TEST_ASSERT_EQUAL_UINT32(1000, aug_get_backoff_delay_ms(2, 500, 30000, 0));
+    TEST_ASSERT_EQUAL_UINT32(15000, aug_get_backoff_delay_ms(6, 500, 30000, 0));
+    TEST_ASSERT_EQUAL_UINT32(15000, aug_get_backoff_delay_ms(1000, 500, 30000, 0));
+}
+
+static void test_backoff_jitter_range(void)
+{
+    for (uint32_t random = 0; random < 5000; random += 7) {
+        uint32_t delay_ms = aug_get_backoff_delay_ms(3, 500, 30000, random);
+        TEST_ASSERT_TRUE(delay_ms >= 2000 && delay_ms <= 4000);
+    }
+    TEST_ASSERT_EQUAL_UINT32(4000, aug_get_backoff_delay_ms(3, 500, 30000, 2000));
+    TEST_ASSERT_EQUAL_UINT32(30000, aug_get_backoff_delay_ms(10, 500, 30000, 15000));
+    TEST_ASSERT_EQUAL_UINT32(0, aug_get_backoff_delay_ms(3, 1, 1, 12345));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_temperature_str_matches_printf);
+    RUN_TEST(test_temperature_str_small_buffer);
+    RUN_TEST(test_temperature_centi);
+    RUN_TEST(test_hex_to_bytes);
+    RUN_TEST(test_auth_mode_round_trip);
+    RUN_TEST(test_report_deadband);
+    RUN_TEST(test_report_min_interval);
+    RUN_TEST(test_report_heartbeat);
+    RUN_TEST(test_backoff_doubles_up_to_max);
+    RUN_TEST(test_backoff_jitter_range);
+    return UNITY_END();
+}
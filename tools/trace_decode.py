@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+"""Decodes the binary trace dumped by the device at /debug/trace.
+
+Usage:
+    curl -o trace.bin "http://espserver/debug/trace"
+    python tools/trace_decode.py trace.bin
+
+The event numbers and arguments mirror aug_trace_event_t in main/include/aug_trace.h.
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = 0x54475541
+VERSION = 1
+HEADER = struct.Struct("<IHHII")
+ENTRY = struct.Struct("<IIHHI")
+
+AUTH_MODES = {0: "open", 1: "wep", 2: "wpa_psk", 3: "wpa2_psk", 4: "wpa_wpa2_psk",
+              6: "wpa3_psk", 7: "wpa2_wpa3_psk", 8: "wapi_psk"}
+SAE_MODES = {1: "hunt_and_peck", 2: "h2e", 3: "both"}
+ERRORS = {0: "ESP_OK", -1: "ESP_FAIL", 0x101: "ESP_ERR_NO_MEM", 0x102: "ESP_ERR_INVALID_ARG",
+          0x103: "ESP_ERR_INVALID_STATE", 0x104: "ESP_ERR_INVALID_SIZE", 0x105: "ESP_ERR_NOT_FOUND",
+          0x107: "ESP_ERR_TIMEOUT", 0x109: "ESP_ERR_INVALID_CRC"}
+
+
+def esp_err(value, bits=32):
+    if value >= 1 << (bits - 1):
+        value -= 1 << bits
+    return ERRORS.get(value, "0x%x" % (value & 0xFFFFFFFF))
+
+
+def unpack_str(value):
+    return struct.pack("<I", value).rstrip(b"\0").decode("ascii", "replace")
+
+
+def format_mode(arg0, arg1):
+    if arg0 == 0:
+        return "auth_mode=%s" % AUTH_MODES.get(arg1, arg1)
+    return "sae_mode=%s" % SAE_MODES.get(arg1, arg1)
+
+
+EVENTS = {
+    1: ("mqtt_enqueue", lambda a0, a1: "result=%s len=%u" % (esp_err(a0, 16), a1)),
+    2: ("mqtt_published", lambda a0, a1: "msg_id=%u" % a1),
+    3: ("publish_skipped", lambda a0, a1: "outbox=%u" % a1),
+    4: ("publish_failed", lambda a0, a1: "sensor=%u result=%s" % (a0, esp_err(a1))),
+    5: ("conversion_failed", lambda a0, a1: "bus=%u result=%s" % (a0, esp_err(a1))),
+    6: ("read_failed", lambda a0, a1: "sensor=%u result=%s" % (a0, esp_err(a1))),
+    7: ("query_option", lambda a0, a1: "key=%s found=%u" % (unpack_str(a1), a0)),
+    8: ("mode_to_str", format_mode),
+}
+
+
+def decode(data, out):
+    if len(data) < HEADER.size:
+        raise ValueError("the dump is shorter than the header")
+    magic, version, entry_size, entries_number, lost = HEADER.unpack_from(data)
+    if magic != MAGIC or version != VERSION or entry_size != ENTRY.size:
+        raise ValueError("unsupported dump: magic 0x%08x, version %u, entry size %u" % (magic, version, entry_size))
+    out.write("# %u entries, %u lost before the dump\n" % (entries_number, lost))
+
+    skipped = 0
+    previous_us = None
+    for offset in range(HEADER.size, min(len(data), HEADER.size + entries_number * ENTRY.size), ENTRY.size):
+        sequence, timestamp_us, event, arg0, arg1 = ENTRY.unpack_from(data, offset)
+        if sequence == 0:
+            skipped += 1
+            continue
+        name, format_args = EVENTS.get(event, ("event_%u" % event, lambda a0, a1: "arg0=%u arg1=%u" % (a0, a1)))
+        delta = "" if previous_us is None else " (+%u us)" % ((timestamp_us - previous_us) & 0xFFFFFFFF)
+        previous_us = timestamp_us
+        out.write("%10u %12.6f s%s %s %s\n" % (sequence, timestamp_us / 1e6, delta, name, format_args(arg0, arg1)))
+    if skipped:
+        out.write("# %u entries were overwritten while dumping\n" % skipped)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("dump", help="file with the dump of /debug/trace")
+    args = parser.parse_args()
+    with open(args.dump, "rb") as dump:
+        decode(dump.read(), sys.stdout)
+
+
+if __name__ == "__main__":
+    main()